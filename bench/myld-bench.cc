@@ -0,0 +1,356 @@
+// myld-bench: link synthetic programs of growing size with myld and a baseline linker, and print the timings as JSON
+//
+// Every object file has M functions, each in its own section (as with -ffunction-sections). A function calls
+// functions of other objects (R_X86_64_PLT32), takes the address of a string literal in a mergeable string section
+// (R_X86_64_PC32), loads a global of another object (R_X86_64_PC32) and the address of a function through the GOT
+// (R_X86_64_REX_GOTPCRELX). Each object also has a pointer table in .data (R_X86_64_64).
+// String literals are shared between objects, so SHF_MERGE deduplication has work to do
+
+#include "myld.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fmt/format.h>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Options {
+    std::vector<u64> sizes = {10, 100, 1000};
+    // functions per object
+    u64 functions = 10;
+    // cross-file calls per object
+    u64 calls = 20;
+    // distinct string literals. each object uses `functions` of them
+    u64 strings = 100;
+    u64 repeat = 3;
+    std::string myld = MYLD_BENCH_LINKER;
+    // empty when no baseline is run
+    std::string baseline = "/usr/bin/ld";
+    std::string work_dir = "myld-bench";
+    std::optional<std::string> output_file = std::nullopt;
+    // extra arguments of myld, e.g. --threads=1
+    std::vector<std::string> myld_args = {};
+};
+
+// resource usage of one run of a command
+struct Run {
+    int exit_code;
+    double wall_ms;
+    double user_ms;
+    double sys_ms;
+    // peak resident set size
+    u64 max_rss_kb;
+};
+
+// 64-bit LCG, so that the same options always generate the same program
+class Random {
+  public:
+    Random(u64 seed) : state(seed) {}
+
+    u64 next(u64 bound) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (state >> 33) % bound;
+    }
+
+  private:
+    u64 state;
+};
+
+std::vector<u64> parse_sizes(const std::string &list) {
+    std::vector<u64> sizes;
+    std::string::size_type start = 0;
+    while (start <= list.size()) {
+        std::string::size_type end = std::min(list.find(',', start), list.size());
+        sizes.push_back(std::stoull(list.substr(start, end - start)));
+        start = end + 1;
+    }
+    return sizes;
+}
+
+std::string function_name(u64 obj, u64 fn) { return fmt::format("f{}_{}", obj, fn); }
+
+// assembly of the `obj`-th of `obj_num` objects
+std::string generate_object(const Options &options, u64 obj, u64 obj_num) {
+    Random random(obj * 0x9e3779b97f4a7c15ULL + 1);
+
+    // callees of each function. calls go to other objects whenever there is one
+    std::vector<std::vector<std::string>> callees(options.functions);
+    for (u64 k = 0; k < options.calls; k++) {
+        u64 callee_obj = obj_num > 1 ? (obj + 1 + random.next(obj_num - 1)) % obj_num : obj;
+        callees[k % options.functions].push_back(function_name(callee_obj, random.next(options.functions)));
+    }
+
+    std::string s;
+    if (obj == 0) {
+        // exit(0)
+        s += ".section .text._start,\"ax\",@progbits\n"
+             ".globl _start\n"
+             ".type _start,@function\n"
+             "_start:\n"
+             "  movq $60, %rax\n"
+             "  xorq %rdi, %rdi\n"
+             "  syscall\n";
+    }
+    for (u64 fn = 0; fn < options.functions; fn++) {
+        std::string name = function_name(obj, fn);
+        s += fmt::format(".section .text.{0},\"ax\",@progbits\n"
+                         ".globl {0}\n"
+                         ".type {0},@function\n"
+                         "{0}:\n",
+                         name);
+        for (auto &callee : callees[fn]) {
+            s += fmt::format("  call {}\n", callee);
+        }
+        s += fmt::format("  leaq .Lstr{}(%rip), %rax\n", fn);
+        s += fmt::format("  movq data{}(%rip), %rax\n", obj_num > 1 ? random.next(obj_num) : obj);
+        s += fmt::format("  movq {}@GOTPCREL(%rip), %rax\n", function_name(random.next(obj_num), fn));
+        s += "  ret\n";
+    }
+
+    s += ".section .rodata.str1.1,\"aMS\",@progbits,1\n";
+    for (u64 fn = 0; fn < options.functions; fn++) {
+        s += fmt::format(".Lstr{}:\n  .string \"string literal {}\"\n", fn, random.next(options.strings));
+    }
+
+    s += fmt::format(".data\n"
+                     ".globl data{0}\n"
+                     ".p2align 3\n"
+                     "data{0}:\n",
+                     obj);
+    for (u64 fn = 0; fn < options.functions; fn++) {
+        s += fmt::format("  .quad {}\n", function_name(obj, fn));
+    }
+    s += ".section .note.GNU-stack,\"\",@progbits\n";
+    return s;
+}
+
+// run `args` in `dir` and wait for it. stdout and stderr are discarded
+Run run_command(const std::vector<std::string> &args, const fs::path &dir) {
+    std::vector<char *> argv;
+    for (auto &arg : args) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        fmt::print(stderr, "Couldn't fork: {}\n", std::strerror(errno));
+        std::exit(1);
+    }
+    if (pid == 0) {
+        if (chdir(dir.c_str()) != 0) {
+            _exit(127);
+        }
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        fmt::print(stderr, "Couldn't wait for {}: {}\n", args[0], std::strerror(errno));
+        std::exit(1);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    auto to_ms = [](const struct timeval &tv) { return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0; };
+    return Run{WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status),
+               std::chrono::duration<double, std::milli>(end - start).count(), to_ms(usage.ru_utime),
+               to_ms(usage.ru_stime), (u64)usage.ru_maxrss};
+}
+
+// generate and assemble the objects of a program with `obj_num` objects, unless it was done before.
+// returns the object filenames, relative to `dir`
+std::vector<std::string> prepare_objects(const Options &options, u64 obj_num, const fs::path &dir) {
+    std::vector<std::string> filenames;
+    for (u64 obj = 0; obj < obj_num; obj++) {
+        filenames.push_back(fmt::format("obj{}.o", obj));
+    }
+    if (fs::exists(dir / "done")) {
+        return filenames;
+    }
+
+    fmt::print(stderr, "generating {} objects in {}\n", obj_num, dir.string());
+    fs::create_directories(dir);
+    std::atomic<bool> ok(true);
+    Myld::Parallel::parallel_for(Myld::Parallel::default_num_threads(), obj_num, [&](u64 obj) {
+        std::string source = fmt::format("obj{}.s", obj);
+        std::ofstream(dir / source) << generate_object(options, obj, obj_num);
+        Run run = run_command({"/usr/bin/as", "--64", source, "-o", filenames[obj]}, dir);
+        if (run.exit_code != 0) {
+            ok = false;
+        }
+        fs::remove(dir / source);
+    });
+    if (!ok) {
+        fmt::print(stderr, "Couldn't assemble the objects in {}\n", dir.string());
+        std::exit(1);
+    }
+    std::ofstream(dir / "done") << "";
+    return filenames;
+}
+
+// link `repeat` times and summarize the runs as a JSON object.
+// times are medians, memory is the maximum. the output is run once to check that it works
+std::string bench_linker(const Options &options, const std::vector<std::string> &args, const fs::path &dir,
+                         const std::string &output) {
+    std::vector<Run> runs;
+    for (u64 i = 0; i < options.repeat; i++) {
+        fs::remove(dir / output);
+        runs.push_back(run_command(args, dir));
+    }
+
+    auto median = [&](double Run::*field) {
+        std::vector<double> values;
+        for (auto &run : runs) {
+            values.push_back(run.*field);
+        }
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    };
+    double min_wall_ms = std::min_element(runs.begin(), runs.end(), [](const Run &a, const Run &b) {
+                             return a.wall_ms < b.wall_ms;
+                         })->wall_ms;
+    u64 max_rss_kb = std::max_element(runs.begin(), runs.end(), [](const Run &a, const Run &b) {
+                         return a.max_rss_kb < b.max_rss_kb;
+                     })->max_rss_kb;
+    int exit_code = runs.back().exit_code;
+
+    bool output_runs = false;
+    u64 output_bytes = 0;
+    if (exit_code == 0 && fs::exists(dir / output)) {
+        output_bytes = fs::file_size(dir / output);
+        fs::permissions(dir / output, fs::perms::owner_exec, fs::perm_options::add);
+        output_runs = run_command({(dir / output).string()}, dir).exit_code == 0;
+    }
+
+    return fmt::format("{{\"exit_code\": {}, \"wall_ms\": {:.3f}, \"min_wall_ms\": {:.3f}, \"user_ms\": {:.3f}, "
+                       "\"sys_ms\": {:.3f}, \"max_rss_kb\": {}, \"output_bytes\": {}, \"output_runs\": {}}}",
+                       exit_code, median(&Run::wall_ms), min_wall_ms, median(&Run::user_ms), median(&Run::sys_ms),
+                       max_rss_kb, output_bytes, output_runs);
+}
+
+void print_usage() {
+    fmt::print("Usage: myld-bench [options] [-- myld options]\n");
+    fmt::print("Links synthetic programs with myld and a baseline linker and prints the timings as JSON\n");
+    fmt::print("Options:\n");
+    fmt::print("  --sizes=N,...\tNumbers of object files (default: 10,100,1000)\n");
+    fmt::print("  --functions=M\tFunctions per object (default: 10)\n");
+    fmt::print("  --calls=K\tCross-file calls per object (default: 20)\n");
+    fmt::print("  --strings=S\tDistinct string literals (default: 100)\n");
+    fmt::print("  --repeat=R\tLinks per linker and size (default: 3)\n");
+    fmt::print("  --myld=path\tmyld to benchmark (default: {})\n", MYLD_BENCH_LINKER);
+    fmt::print("  --baseline=path\n\t\tLinker to compare with (default: /usr/bin/ld). empty for none\n");
+    fmt::print("  --work-dir=dir\tWhere objects are generated and kept between runs (default: myld-bench)\n");
+    fmt::print("  -o file\tWrite the JSON to file instead of stdout\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value_of = [&](std::string option) -> std::optional<std::string> {
+            if (arg.starts_with(option + "=")) {
+                return arg.substr(option.size() + 1);
+            }
+            return std::nullopt;
+        };
+        try {
+            if (arg == "--") {
+                options.myld_args.assign(argv + i + 1, argv + argc);
+                break;
+            } else if (auto value = value_of("--sizes")) {
+                options.sizes = parse_sizes(value.value());
+            } else if (auto value = value_of("--functions")) {
+                options.functions = std::stoull(value.value());
+            } else if (auto value = value_of("--calls")) {
+                options.calls = std::stoull(value.value());
+            } else if (auto value = value_of("--strings")) {
+                options.strings = std::stoull(value.value());
+            } else if (auto value = value_of("--repeat")) {
+                options.repeat = std::stoull(value.value());
+            } else if (auto value = value_of("--myld")) {
+                options.myld = fs::absolute(value.value()).string();
+            } else if (auto value = value_of("--baseline")) {
+                options.baseline = value->empty() ? "" : fs::absolute(value.value()).string();
+            } else if (auto value = value_of("--work-dir")) {
+                options.work_dir = value.value();
+            } else if (arg == "-o" && i + 1 < argc) {
+                options.output_file = argv[++i];
+            } else if (arg == "-h" || arg == "--help") {
+                print_usage();
+                return 0;
+            } else {
+                fmt::print(stderr, "unknown option: {}\n", arg);
+                return 1;
+            }
+        } catch (const std::logic_error &) {
+            fmt::print(stderr, "invalid number: {}\n", arg);
+            return 1;
+        }
+    }
+    if (options.functions == 0 || options.strings == 0 || options.repeat == 0 ||
+        std::find(options.sizes.begin(), options.sizes.end(), 0) != options.sizes.end()) {
+        fmt::print(stderr, "sizes, --functions, --strings and --repeat must be positive\n");
+        return 1;
+    }
+
+    std::vector<std::string> results;
+    for (u64 obj_num : options.sizes) {
+        fs::path dir = fs::absolute(options.work_dir) /
+                       fmt::format("n{}-m{}-k{}-s{}", obj_num, options.functions, options.calls, options.strings);
+        std::vector<std::string> objs = prepare_objects(options, obj_num, dir);
+        u64 input_bytes = 0;
+        for (auto &obj : objs) {
+            input_bytes += fs::file_size(dir / obj);
+        }
+
+        fmt::print(stderr, "linking {} objects with {}\n", obj_num, options.myld);
+        std::vector<std::string> myld_args = {options.myld};
+        myld_args.insert(myld_args.end(), objs.begin(), objs.end());
+        myld_args.insert(myld_args.end(), {"-o", "myld.out"});
+        myld_args.insert(myld_args.end(), options.myld_args.begin(), options.myld_args.end());
+        std::string result = fmt::format(
+            "{{\"objects\": {}, \"functions_per_object\": {}, \"calls_per_object\": {}, \"input_bytes\": {}, "
+            "\"myld\": {}",
+            obj_num, options.functions, options.calls, input_bytes, bench_linker(options, myld_args, dir, "myld.out"));
+
+        if (!options.baseline.empty()) {
+            fmt::print(stderr, "linking {} objects with {}\n", obj_num, options.baseline);
+            std::vector<std::string> baseline_args = {options.baseline, "-static", "-nostdlib", "-o", "baseline.out"};
+            baseline_args.insert(baseline_args.end(), objs.begin(), objs.end());
+            result += fmt::format(", \"baseline\": {}", bench_linker(options, baseline_args, dir, "baseline.out"));
+        }
+        results.push_back(result + "}");
+    }
+
+    std::string json = fmt::format("{{\"myld\": \"{}\", \"baseline\": \"{}\", \"repeat\": {}, \"results\": [\n  {}\n]}}\n",
+                                   options.myld, options.baseline, options.repeat, fmt::join(results, ",\n  "));
+    if (options.output_file.has_value()) {
+        std::ofstream(options.output_file.value()) << json;
+    } else {
+        fmt::print("{}", json);
+    }
+    return 0;
+}
@@ -0,0 +1,201 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include "mapped-file.h"
+#include "myld.h"
+#include <cassert>
+#include <cstring>
+#include <fmt/core.h>
+#include <fmt/format.h>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Myld {
+namespace Parse {
+
+// static library (`ar` archive), regular or thin.
+// only the symbol index is parsed up front. a member is located and parsed only when `get_member()` is called
+class Archive {
+  public:
+    // member of an archive
+    struct Member {
+        // e.g. "libfoo.a(bar.o)"
+        std::string name;
+        // the file the member is in: the archive, or the external file for thin archives
+        std::shared_ptr<const MappedFile> file;
+        // contents of the member. for thin archives this is the whole external file
+        Raw raw;
+    };
+
+    static bool is_archive(const MappedFile &file) {
+        return file.get_size() >= kMagicSize &&
+               (std::memcmp(file.get_data(), kMagic, kMagicSize) == 0 ||
+                std::memcmp(file.get_data(), kThinMagic, kMagicSize) == 0);
+    }
+
+    Archive(std::string filename, std::shared_ptr<const MappedFile> file)
+        : filename(filename), file(file), raw(Raw(*file)), long_names(std::nullopt), symbols({}) {
+        assert(is_archive(*file));
+        is_thin = std::memcmp(file->get_data(), kThinMagic, kMagicSize) == 0;
+
+        // the symbol index and the long name table come before the first regular member
+        bool has_index = false;
+        u64 offset = kMagicSize;
+        while (offset + sizeof(Header) <= raw.get_size()) {
+            const Header *header = get_header(offset);
+            std::string name = trim(header->name, sizeof(header->name));
+            u64 size = header->get_size();
+            if (name != "/" && name != "/SYM64/" && name != "//") {
+                break;
+            }
+
+            // these are stored in the archive even if it is thin
+            Raw body = raw.get_sub(offset + sizeof(Header), size);
+            if (name == "/") {
+                read_index(body, 4);
+                has_index = true;
+            } else if (name == "/SYM64/") {
+                read_index(body, 8);
+                has_index = true;
+            } else {
+                long_names = body;
+            }
+            offset += sizeof(Header) + size + (size % 2);
+        }
+
+        if (!has_index) {
+            fmt::print("{} has no symbol index (run ranlib on it)\n", filename);
+            std::exit(1);
+        }
+    }
+
+    std::string get_filename() const { return filename; }
+
+    // (symbol name, offset of the member which defines it) of the symbol index
+    const std::vector<std::pair<std::string, u64>> &get_symbols() const { return symbols; }
+
+    // member whose header is at `offset`, as given by `get_symbols()`
+    Member get_member(u64 offset) const {
+        const Header *header = get_header(offset);
+        std::string name = get_member_name(*header);
+        u64 size = header->get_size();
+
+        if (is_thin) {
+            // thin archives only store the path of the member, relative to the archive
+            std::string path = name;
+            if (!path.starts_with("/")) {
+                auto slash = filename.find_last_of('/');
+                if (slash != std::string::npos) {
+                    path = filename.substr(0, slash + 1) + path;
+                }
+            }
+            std::shared_ptr<const MappedFile> file = MappedFile::open(path);
+            if (file->get_size() != size) {
+                fmt::print("{}: member {} has changed since the archive was created\n", filename, path);
+                std::exit(1);
+            }
+            return Member{fmt::format("{}({})", filename, name), file, Raw(*file)};
+        }
+        return Member{fmt::format("{}({})", filename, name), file, raw.get_sub(offset + sizeof(Header), size)};
+    }
+
+  private:
+    // header of each member. every field is padded ASCII
+    struct Header {
+        char name[16];
+        char date[12];
+        char uid[6];
+        char gid[6];
+        char mode[8];
+        char size[10];
+        char fmag[2];
+
+        u64 get_size() const { return std::stoull(std::string(size, sizeof(size))); }
+    };
+    static_assert(sizeof(Header) == 60);
+
+    static constexpr u64 kMagicSize = 8;
+    static constexpr const char *kMagic = "!<arch>\n";
+    static constexpr const char *kThinMagic = "!<thin>\n";
+
+    std::string filename;
+    std::shared_ptr<const MappedFile> file;
+    Raw raw;
+    bool is_thin;
+    // GNU long name table ("//" member)
+    std::optional<Raw> long_names;
+    std::vector<std::pair<std::string, u64>> symbols;
+
+    const Header *get_header(u64 offset) const {
+        const Header *header = (const Header *)raw.get_sub(offset, sizeof(Header)).to_pointer();
+        if (std::memcmp(header->fmag, "`\n", 2) != 0) {
+            fmt::print("{}: corrupted member header at offset 0x{:x}\n", filename, offset);
+            std::exit(1);
+        }
+        return header;
+    }
+
+    static std::string trim(const char *s, u64 size) {
+        std::string str(s, size);
+        return str.substr(0, str.find_last_not_of(' ') + 1);
+    }
+
+    // member names are "name/" or "/<offset into the long name table>"
+    std::string get_member_name(const Header &header) const {
+        std::string name = trim(header.name, sizeof(header.name));
+        if (name.starts_with("/") && name.size() > 1) {
+            assert(long_names.has_value());
+            u64 start = std::stoull(name.substr(1));
+            const char *begin = (const char *)long_names->begin() + start;
+            const char *end = (const char *)long_names->end();
+            const char *p = begin;
+            while (p < end && *p != '\n') {
+                p++;
+            }
+            name = std::string(begin, p);
+        }
+        if (name.ends_with("/")) {
+            name.pop_back();
+        }
+        return name;
+    }
+
+    // big-endian integer of `width` bytes
+    static u64 read_be(const u8 *p, u64 width) {
+        u64 value = 0;
+        for (u64 i = 0; i < width; i++) {
+            value = (value << 8) | p[i];
+        }
+        return value;
+    }
+
+    // the index is: number of symbols, the member offset of each symbol, then NUL-terminated symbol names
+    void read_index(Raw body, u64 width) {
+        const u8 *p = body.begin();
+        u64 symbol_num = read_be(p, width);
+        if ((symbol_num + 1) * width > body.get_size()) {
+            fmt::print("{}: corrupted symbol index\n", filename);
+            std::exit(1);
+        }
+        const char *name = (const char *)p + (symbol_num + 1) * width;
+        const char *end = (const char *)body.end();
+        symbols.reserve(symbol_num);
+        for (u64 i = 0; i < symbol_num; i++) {
+            if (name >= end) {
+                fmt::print("{}: corrupted symbol index\n", filename);
+                std::exit(1);
+            }
+            u64 len = strnlen(name, end - name);
+            symbols.push_back(std::make_pair(std::string(name, len), read_be(p + (i + 1) * width, width)));
+            name += len + 1;
+        }
+    }
+};
+
+} // namespace Parse
+} // namespace Myld
+
+#endif
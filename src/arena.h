@@ -0,0 +1,72 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "myld.h"
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Myld {
+
+// bump allocator. everything allocated from an arena is freed at once when the arena is destroyed, and destructors
+// are never run, so only trivially destructible types can be allocated.
+// not thread-safe: each object file has its own arena, filled by the thread parsing it
+class Arena {
+  public:
+    Arena() : chunks(), cur(nullptr), left(0) {}
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    Arena(Arena &&) = default;
+    Arena &operator=(Arena &&) = default;
+
+    template <typename T, typename... Args> T *create(Args &&...args) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // `n` objects made by `fn(i)`
+    template <typename T, typename F> std::span<T> create_array(u64 n, F fn) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        if (n == 0) {
+            return {};
+        }
+        T *array = (T *)allocate(sizeof(T) * n, alignof(T));
+        for (u64 i = 0; i < n; i++) {
+            new (&array[i]) T(fn(i));
+        }
+        return std::span<T>(array, n);
+    }
+
+  private:
+    static constexpr u64 kMinChunkSize = 64 * 1024;
+
+    std::vector<std::unique_ptr<u8[]>> chunks;
+    u8 *cur;
+    u64 left;
+
+    void *allocate(u64 size, u64 align) {
+        u64 padding = align_to((u64)cur, align) - (u64)cur;
+        if (cur == nullptr || padding + size > left) {
+            // chunks are at least as large as the biggest allocation, so one allocation never spans two chunks
+            u64 chunk_size = std::max(kMinChunkSize, size + align);
+            chunks.push_back(std::make_unique_for_overwrite<u8[]>(chunk_size));
+            cur = chunks.back().get();
+            left = chunk_size;
+            padding = align_to((u64)cur, align) - (u64)cur;
+        }
+        void *p = cur + padding;
+        cur += padding + size;
+        left -= padding + size;
+        return p;
+    }
+};
+
+} // namespace Myld
+
+#endif
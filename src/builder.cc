@@ -6,7 +6,40 @@ namespace Myld {
 void Context::build_and_output() {
     Myld::Build::Builder builder{};
     builder.build(*this);
-    builder.output(this->config.get_output_filename());
+    builder.output(*this, this->config.get_output_filename());
 };
 
+void Context::print_stats() const {
+    u64 input_section_num = 0;
+    u64 input_symbol_num = 0;
+    for (auto &obj : objs) {
+        input_section_num += obj->get_section_num();
+        input_symbol_num += obj->get_sym_table()->get_symbol_num();
+    }
+    u64 laid_out_section_num = 0;
+    for (auto &output_section : output_sections) {
+        laid_out_section_num += output_section->get_members().size();
+    }
+
+    fmt::print("stats:\n");
+    fmt::print("  input files: {} ({} bytes)\n", stats.input_file_num, stats.input_bytes);
+    fmt::print("  object files: {}\n", objs.size());
+    fmt::print("  input sections: {} ({} laid out)\n", input_section_num, laid_out_section_num);
+    fmt::print("  output sections: {}\n", output_sections.size());
+    fmt::print("  input symbols: {}\n", input_symbol_num);
+    fmt::print("  output symbols: {}\n", linked_sym_table.get_output_symbol_num());
+    fmt::print("  relocations: {}\n", stats.relocation_num);
+    fmt::print("  output size: {} bytes\n", stats.output_bytes);
+    fmt::print("  peak RSS: {} bytes\n", get_peak_rss());
+
+    // phases run on the main thread. per-file and per-section timers are only in the --time-trace output
+    fmt::print("time:\n");
+    for (auto &event : time_trace.get_events()) {
+        if (event.worker == 0 && event.detail.empty()) {
+            fmt::print("  {:{}}{:<{}} {:>10.3f} ms\n", "", event.depth * 2, event.name, 32 - event.depth * 2,
+                       event.duration_us / 1000.0);
+        }
+    }
+}
+
 } // namespace Myld
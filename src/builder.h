@@ -3,14 +3,18 @@
 
 #include "context.h"
 #include "elf-util.h"
+#include "log.h"
 #include "myld.h"
+#include "output-file.h"
+#include "parallel.h"
+#include "relocation.h"
+#include "section.h"
+#include "string-table.h"
 #include <cassert>
 #include <elf.h>
-#include <fstream>
+#include <cstring>
 #include <optional>
-
-// use ""s
-using namespace std::literals::string_literals;
+#include <unordered_map>
 
 namespace Myld {
 namespace Build {
@@ -20,7 +24,7 @@ using namespace Myld;
 class Section {
   public:
     Section(std::string name, std::shared_ptr<Elf64_Shdr> sheader)
-        : sheader(sheader), name(name), padding_size(std::nullopt), raw({}) {}
+        : sheader(sheader), name(name), padding_size(std::nullopt), raw({}), output_section(nullptr) {}
 
     void finalize(u64 padding, u64 offset) {
         set_padding_size(padding);
@@ -30,7 +34,7 @@ class Section {
         }
     }
 
-    std::string get_name() const { return name; }
+    const std::string &get_name() const { return name; }
 
     u64 get_padding_size() const {
         assert(padding_size.has_value());
@@ -38,10 +42,24 @@ class Section {
     }
 
     void set_raw(std::vector<u8> raw_) {
-        raw = raw_;
-        sheader->sh_size = raw_.size();
+        raw = std::move(raw_);
+        sheader->sh_size = raw.size();
+    }
+    const std::vector<u8> &get_raw() const { return raw; }
+
+    // the section is written from an output section of the linker instead of `raw`
+    void set_output_section(std::shared_ptr<OutputSection> output_section_) {
+        assert(raw.empty());
+        output_section = output_section_;
+        sheader->sh_size = output_section->get_size();
+    }
+    std::shared_ptr<OutputSection> get_output_section() const { return output_section; }
+
+    // the section is written straight to the output file by the builder (e.g. .symtab) instead of from `raw`
+    void set_size(u64 size) {
+        assert(raw.empty() && output_section == nullptr);
+        sheader->sh_size = size;
     }
-    std::vector<u8> get_raw() const { return raw; }
 
     std::shared_ptr<Elf64_Shdr> sheader;
 
@@ -50,6 +68,7 @@ class Section {
     // padding just before the section
     std::optional<u64> padding_size;
     std::vector<u8> raw;
+    std::shared_ptr<OutputSection> output_section;
 
     void set_padding_size(u64 size) {
         assert(!padding_size.has_value());
@@ -61,98 +80,150 @@ class Builder {
   public:
     Builder() {}
 
-    void output(std::string filename) {
-        std::ofstream stream = std::ofstream(filename, std::ios::binary | std::ios::trunc);
-        u64 current_offset = 0;
+    void output(Context &ctx, std::string filename) {
+        u64 num_threads = ctx.config.get_num_threads();
+        u64 file_size = eheader.e_shoff + sections.size() * sizeof(Elf64_Shdr);
+        ctx.stats.output_bytes = file_size;
+        ScopedTimer write_timer(ctx.time_trace, "write output");
+        OutputFile file(filename, file_size);
+        u8 *buf = file.get_data();
 
         // elf header
-        fmt::print("writing elf header\n");
-        stream.write((char *)&eheader, sizeof(Elf64_Ehdr));
-        current_offset += sizeof(Elf64_Ehdr);
+        MYLD_TRACE(Output, "writing elf header\n");
+        std::memcpy(buf, &eheader, sizeof(Elf64_Ehdr));
 
         // program header
-        fmt::print("writing program header\n");
-        stream.write((char *)&pheader, sizeof(Elf64_Phdr));
-        current_offset += sizeof(Elf64_Phdr);
+        MYLD_TRACE(Output, "writing program header\n");
+        std::memcpy(buf + eheader.e_phoff, pheaders.data(), pheaders.size() * sizeof(Elf64_Phdr));
+
+        // section bodies generated by the linker
+        // Padding between them is never written. The file starts out as zeros, so it costs nothing
+        MYLD_TRACE(Output, "writing section bodies\n");
+        {
+            ScopedTimer timer(ctx.time_trace, "copy sections");
+            Parallel::parallel_for(num_threads, sections.size(), [&](u64 i) {
+                if (sections[i]->sheader->sh_type == SHT_NOBITS) {
+                    return;
+                }
+                const std::vector<u8> &content = (sections[i]->get_output_section() != nullptr)
+                                                     ? sections[i]->get_output_section()->get_content()
+                                                     : sections[i]->get_raw();
+                if (content.size() > 0) {
+                    assert(sections[i]->sheader->sh_offset + content.size() <= eheader.e_shoff);
+                    std::memcpy(buf + sections[i]->sheader->sh_offset, content.data(), content.size());
+                }
+            });
+
+            // input sections
+            // This is the only copy of their bytes: straight from the input mappings into the output mapping
+            std::vector<std::shared_ptr<InputSection>> input_sections;
+            for (auto &output_section : ctx.output_sections) {
+                if (output_section->get_type() == SHT_NOBITS) {
+                    continue;
+                }
+                input_sections.insert(input_sections.end(), output_section->get_members().begin(),
+                                      output_section->get_members().end());
+            }
+            Parallel::parallel_for(num_threads, input_sections.size(), [&](u64 i) {
+                const InputSection &input_section = *input_sections[i];
+                Raw raw = input_section.get_raw();
+                u8 *dest = buf + input_section.get_output_section()->get_offset() + input_section.get_offset();
+                std::memcpy(dest, raw.begin(), raw.get_size());
+            });
+        }
 
-        // 0x1000からセクション本体が始まるようにpadding
-        fmt::print("inserting paddin after program header\n");
-        std::fill_n(std::ostream_iterator<char>(stream), padding_after_pheader, '\0');
-        current_offset += padding_after_pheader;
+        {
+            ScopedTimer timer(ctx.time_trace, "write .symtab and .strtab");
+            ctx.linked_sym_table.write_output(num_threads, buf + get_section_by_name(".symtab")->sheader->sh_offset,
+                                              buf + get_section_by_name(".strtab")->sheader->sh_offset);
+        }
 
-        // section bodies
-        fmt::print("writing section bodies\n");
-        for (int i = 0; i < sections.size(); i++) {
-            fmt::print("body of section [{}]\n", i);
-            fmt::print("  padding before body:  0x{:x}\n", sections[i]->get_padding_size());
-            std::fill_n(std::ostream_iterator<char>(stream), sections[i]->get_padding_size(), '\0');
-            current_offset += sections[i]->get_padding_size();
-
-            fmt::print("  body size:  0x{:x}\n", sections[i]->sheader->sh_size);
-            assert(current_offset == sections[i]->sheader->sh_offset);
-            stream.write((char *)&(sections[i]->get_raw()[0]), sections[i]->sheader->sh_size);
-            current_offset += sections[i]->sheader->sh_size;
+        // relocations are applied in place
+        MYLD_TRACE(Output, "resolving address\n");
+        {
+            ScopedTimer timer(ctx.time_trace, "apply relocations");
+            if (!apply_all_relocations(ctx, buf, ctx.stats.relocation_num)) {
+                file.close();
+                unlink(filename.c_str());
+                std::exit(1);
+            }
         }
 
         // section headers
-        fmt::print("writing section header\n");
-        assert(current_offset == eheader.e_shoff);
+        MYLD_TRACE(Output, "writing section header\n");
         for (int i = 0; i < sections.size(); i++) {
-            fmt::print("header of section [{}]\n", i);
-            stream.write((char *)&(*(sections[i]->sheader)), sizeof(Elf64_Shdr));
-            current_offset += sizeof(Elf64_Shdr);
+            std::memcpy(buf + eheader.e_shoff + i * sizeof(Elf64_Shdr), sections[i]->sheader.get(), sizeof(Elf64_Shdr));
         }
+
+        // unmapping a shared mapping (or writing the buffer) is where the bytes reach the file
+        ScopedTimer close_timer(ctx.time_trace, "close output");
+        file.close();
     }
 
-    void build(Context ctx) {
+    void build(Context &ctx) {
         // elf header
         eheader = Utils::create_dummy_eheader();
-        // program header
-        pheader =
-            Utils::create_dummy_pheader_load(ctx.config.get_text_load_addr(), ctx.config.get_text_load_addr(), 0x1000);
-
-        current_load_addr = ctx.config.get_text_load_addr();
-
         // null
         create_section(ctx, "", {});
 
-        // .text
-        create_section(ctx, ".text", ctx.section_raws[".text"]);
-
-        // .rodata
-        // std::optional<Section> rodata_section = std::nullopt;
-        if (ctx.section_raws[".rodata"].size() > 0) {
-            create_section(ctx, ".rodata", ctx.section_raws[".rodata"]);
+        // sections made by the linker, e.g. .text, .rodata, .data, .got
+        // empty ones (e.g. .bss of programs without zero-initialized data) are omitted
+        for (auto &output_section : ctx.output_sections) {
+            if (output_section->get_size() == 0) {
+                continue;
+            }
+            create_section(ctx, output_section->get_name(), {})->set_output_section(output_section);
         }
 
-        // .data, .data*name*
-        // TODO:
-
-        // .symtab
-        create_section(ctx, ".symtab", ctx.linked_sym_table.to_symtab_section_body());
-
-        // .strtab
-        create_section(ctx, ".strtab", ctx.linked_sym_table.to_strtab_section_body());
+        // .symtab and .strtab. only their sizes are known here, their contents are written by `output()`
+        {
+            ScopedTimer timer(ctx.time_trace, "layout .symtab and .strtab");
+            ctx.linked_sym_table.layout_output(ctx.config.get_num_threads(), get_output_shndxs(ctx));
+            create_section(ctx, ".symtab", {})->set_size(ctx.linked_sym_table.get_output_symtab_size());
+            create_section(ctx, ".strtab", {})->set_size(ctx.linked_sym_table.get_output_strtab_size());
+        }
 
-        // .shstrtab
-        create_section(ctx, ".shstrtab", std::vector<u8>(shstrtab_content.begin(), shstrtab_content.end()));
+        // .shstrtab names every section, itself included
+        {
+            auto shstrtab_section = create_section(ctx, ".shstrtab", {});
+            std::vector<std::string_view> section_names;
+            for (auto &section : sections) {
+                section_names.push_back(section->get_name());
+            }
+            StringTable shstrtab(section_names, 1);
+            std::vector<u8> content(shstrtab.get_size());
+            shstrtab.write(1, content.data());
+            for (u64 i = 0; i < sections.size(); i++) {
+                sections[i]->sheader->sh_name = shstrtab.get_offset(i);
+            }
+            shstrtab_section->set_raw(content);
+        }
 
         // calculate padding before each section
-        u64 first_section_start_offset = 0x1000;
+        // Sections loaded by the same PT_LOAD segment are consecutive (see `get_segment_flags()`). A segment starts
+        // at the alignment of its first address in the file too, and its sections keep the distances between their
+        // addresses, so the kernel maps the file as is. SHT_NOBITS sections occupy no bytes in the file
+        u64 first_section_start_offset = Config::kPageSize;
         u64 section_start_offset = first_section_start_offset;
-        padding_after_pheader = section_start_offset - sizeof(Elf64_Ehdr) - sizeof(Elf64_Phdr);
-        fmt::print("padding after pheader: 0x{:x}\n", padding_after_pheader);
-        fmt::print("finalizing section\n");
+        MYLD_TRACE(Layout, "finalizing section\n");
         for (int i = 0; i < sections.size(); i++) {
-            fmt::print("section [{}]: ", i);
             u64 align = sections[i]->sheader->sh_addralign;
-            fmt::print("offset = 0x{:x}, ", section_start_offset);
-            fmt::print("size = 0x{:x}, ", sections[i]->sheader->sh_size);
-            fmt::print("align = 0x{:x}, ", align);
 
             u64 padding_size;
+            auto output_section = sections[i]->get_output_section();
             if (sections[i]->sheader->sh_type == SHT_NULL) {
                 padding_size = 0;
+            } else if (output_section != nullptr) {
+                u32 segment_flags = get_segment_flags(*output_section);
+                if (pheaders.empty() || pheaders.back().p_flags != segment_flags) {
+                    u64 segment_align = ctx.config.get_segment_align(segment_flags);
+                    assert(output_section->get_addr() % segment_align == 0);
+                    pheaders.push_back(Utils::create_dummy_pheader_load(
+                        segment_flags, align_to(section_start_offset, segment_align), output_section->get_addr(),
+                        segment_align));
+                }
+                const Elf64_Phdr &segment = pheaders.back();
+                padding_size = segment.p_offset + (output_section->get_addr() - segment.p_vaddr) - section_start_offset;
             } else {
                 if ((section_start_offset % align) != 0) {
                     padding_size = align - (section_start_offset % align);
@@ -160,43 +231,52 @@ class Builder {
                     padding_size = 0;
                 }
             }
-            fmt::print("padding = 0x{:x}\n", padding_size);
+            MYLD_TRACE(Layout, "section [{}]: offset = 0x{:x}, size = 0x{:x}, align = 0x{:x}, padding = 0x{:x}\n", i,
+                       section_start_offset, sections[i]->sheader->sh_size, align, padding_size);
             section_start_offset += padding_size;
             sections[i]->finalize(padding_size, section_start_offset);
-            section_start_offset += sections[i]->sheader->sh_size;
-        }
+            if (output_section != nullptr) {
+                output_section->set_offset(section_start_offset);
+            }
+            if (sections[i]->sheader->sh_type != SHT_NOBITS) {
+                section_start_offset += sections[i]->sheader->sh_size;
+            }
 
-        // calulate distance from first section start to last section end
-        u64 dist_from_sections_start_to_sections_end = 0;
-        for (int i = 0; i < sections.size(); i++) {
-            dist_from_sections_start_to_sections_end += sections[i]->get_padding_size();
-            dist_from_sections_start_to_sections_end += sections[i]->sheader->sh_size;
+            if (output_section != nullptr) {
+                Elf64_Phdr &segment = pheaders.back();
+                u64 filesz = (sections[i]->sheader->sh_type == SHT_NOBITS) ? segment.p_filesz
+                                                                           : section_start_offset - segment.p_offset;
+                u64 memsz = output_section->get_addr() + output_section->get_size() - segment.p_vaddr;
+                Utils::finalize_pheader_load(&segment, filesz, memsz);
+            }
+        }
+        padding_after_pheader = first_section_start_offset - sizeof(Elf64_Ehdr) - pheaders.size() * sizeof(Elf64_Phdr);
+        MYLD_TRACE(Layout, "padding after pheader: 0x{:x}\n", padding_after_pheader);
+        assert(sizeof(Elf64_Ehdr) + pheaders.size() * sizeof(Elf64_Phdr) <= first_section_start_offset);
+
+        MYLD_TRACE(Layout, "finalize elf header\n");
+        u64 sheader_start_offset = align_to(section_start_offset, alignof(Elf64_Shdr));
+        MYLD_TRACE(Layout, "start of section header: 0x{:x} = {}\n", sheader_start_offset, sheader_start_offset);
+        Utils::finalize_eheader(&eheader, ctx._start_addr.value(), pheaders.size(), sections.size(),
+                                sheader_start_offset);
+        MYLD_TRACE(Layout, "program headers:\n");
+        for (auto &segment : pheaders) {
+            MYLD_TRACE(Layout, " LOAD offset = 0x{:x}, vaddr = 0x{:x}, filesz = 0x{:x}, memsz = 0x{:x}, flags = {}{}{}\n",
+                       segment.p_offset, segment.p_vaddr, segment.p_filesz, segment.p_memsz,
+                       (segment.p_flags & PF_R) ? "R" : "", (segment.p_flags & PF_W) ? "W" : "",
+                       (segment.p_flags & PF_X) ? "X" : "");
         }
-
-        fmt::print("finalize elf header\n");
-        u64 sheader_start_offset = first_section_start_offset + dist_from_sections_start_to_sections_end;
-        fmt::print("start of section header: 0x{:x} = {}\n", sheader_start_offset, sheader_start_offset);
-        Utils::finalize_eheader(&eheader, ctx._start_addr.value(), 1, sections.size(), sheader_start_offset);
-        // とりあえず、.textセクションのみロードする
-        fmt::print("finalize program header\n");
-        auto text_section = get_section_by_name(".text");
-        assert(text_section != nullptr);
-        u64 load_offset = text_section->sheader->sh_offset;
-        u64 load_size = text_section->sheader->sh_size;
-        Utils::finalize_pheader_load(&pheader, load_offset, load_size);
     }
 
   private:
     // output
     Elf64_Ehdr eheader;
-    Elf64_Phdr pheader;
+    // one PT_LOAD for each run of output sections with the same permissions
+    std::vector<Elf64_Phdr> pheaders;
     u64 padding_after_pheader;
 
     std::vector<std::shared_ptr<Section>> sections;
 
-    std::string shstrtab_content;
-    u64 current_load_addr;
-
     std::shared_ptr<Section> get_section_by_name(std::string name) {
         for (auto section : sections) {
             if (section->get_name() == name) {
@@ -206,8 +286,47 @@ class Builder {
         return nullptr;
     }
 
-    void create_section(const Context ctx, std::string section_name, std::vector<u8> raw) {
-        fmt::print("creating section {}\n", section_name);
+    // st_shndx of each linked symbol in the output, indexed by `SymbolId`. symbols of sections folded by --icf are
+    // in the section they were folded into. symbols of sections which are not in the output (removed by
+    // --gc-sections, not laid out or empty) have no valid address and are dropped
+    std::vector<u32> get_output_shndxs(const Context &ctx) const {
+        std::unordered_map<const OutputSection *, u32> output_section_shndxs;
+        for (u64 i = 0; i < sections.size(); i++) {
+            if (sections[i]->get_output_section() != nullptr) {
+                output_section_shndxs[sections[i]->get_output_section().get()] = i;
+            }
+        }
+        auto find_shndx = [&](const OutputSection *output_section) {
+            auto it = output_section_shndxs.find(output_section);
+            return it == output_section_shndxs.end() ? LinkedSymTable::kDropSymbol : it->second;
+        };
+
+        const LinkedSymTable &symbols = ctx.linked_sym_table;
+        std::vector<u32> shndxs(symbols.get_symbol_num());
+        Parallel::parallel_for(ctx.config.get_num_threads(), shndxs.size(), [&](SymbolId id) {
+            u32 obj_index = symbols.get_obj_index(id);
+            u16 shndx = symbols.get_shndx(id);
+            if (shndx == SHN_COMMON) {
+                // COMMON symbols are allocated in .bss
+                shndxs[id] = find_shndx(ctx.get_output_section(".bss").get());
+            } else if (obj_index == kNoObjIndex || shndx == SHN_UNDEF || shndx >= SHN_LORESERVE) {
+                shndxs[id] = shndx;
+            } else if (!ctx.is_live(obj_index, shndx)) {
+                shndxs[id] = LinkedSymTable::kDropSymbol;
+            } else if (auto mergeable_section = ctx.get_mergeable_section(obj_index, shndx);
+                       mergeable_section != nullptr) {
+                shndxs[id] = find_shndx(mergeable_section->get_parent()->get_output_section());
+            } else if (auto input_section = ctx.get_input_section(obj_index, shndx); input_section != nullptr) {
+                shndxs[id] = find_shndx(input_section->get_output_section());
+            } else {
+                shndxs[id] = LinkedSymTable::kDropSymbol;
+            }
+        });
+        return shndxs;
+    }
+
+    std::shared_ptr<Section> create_section(const Context &ctx, std::string section_name, std::vector<u8> raw) {
+        MYLD_TRACE(Layout, "creating section {}\n", section_name);
         u32 type = 0;
         u64 flags = 0;
         u64 addr = 0;
@@ -223,49 +342,30 @@ class Builder {
             entsize = sizeof(Elf64_Sym);
             // .strtabのsection header index
             link = sections.size() + 1;
-            info =
-                ctx.linked_sym_table.get_local_symbol_num(); // TODO: 最後のローカルシンボルのindex + 1とするのが正しい
+            // index of the first global symbol
+            info = ctx.linked_sym_table.get_output_local_num();
         } else if (section_name == ".strtab") {
             type = SHT_STRTAB;
             addralign = 1;
         } else if (section_name == ".shstrtab") {
             type = SHT_STRTAB;
             addralign = 1;
-        } else if (section_name == ".text") {
-            type = SHT_PROGBITS;
-            addralign = 1;
-            flags = SHF_ALLOC | SHF_EXECINSTR; // AX
-            addr = current_load_addr;
-            current_load_addr += raw.size();
-        } else if (section_name == ".rodata") {
-            type = SHT_PROGBITS;
-            addralign = 1;
-            flags = SHF_ALLOC; // A
-            addr = current_load_addr;
-            current_load_addr += raw.size();
-        } else if (section_name.starts_with(".data")) {
-            type = SHT_PROGBITS;
-            addralign = 1;
-            flags = SHF_WRITE | SHF_ALLOC; // WA
-            addr = current_load_addr;
-            current_load_addr += raw.size();
+        } else if (auto output_section = ctx.get_output_section(section_name); output_section != nullptr) {
+            type = output_section->get_type();
+            addralign = output_section->get_align();
+            flags = output_section->get_flags();
+            addr = output_section->get_addr();
         } else {
             fmt::print("unknown section name {}\n", section_name);
             std::exit(1);
         }
-        fmt::print("name index: {} size: {}\n", shstrtab_content.size(), section_name.size());
-        auto sheader =
-            Utils::create_dummy_sheader(shstrtab_content.size(), type, flags, addr, link, info, addralign, entsize);
-        shstrtab_content += section_name + "\0"s;
+        // sh_name is set when .shstrtab is built
+        auto sheader = Utils::create_dummy_sheader(0, type, flags, addr, link, info, addralign, entsize);
 
         Section section = Section(section_name, sheader);
-        // FIXME: ここで足しておかないとバグる
-        if (section_name == ".shstrtab") {
-            std::string n(".shstrtab\0"s);
-            raw.insert(raw.end(), n.begin(), n.end());
-        }
         section.set_raw(raw);
         sections.push_back(std::make_shared<Section>(section));
+        return sections.back();
     }
 };
 
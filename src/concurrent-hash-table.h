@@ -0,0 +1,77 @@
+#ifndef CONCURRENT_HASH_TABLE_H
+#define CONCURRENT_HASH_TABLE_H
+
+#include "myld.h"
+#include <atomic>
+#include <cassert>
+#include <memory>
+
+namespace Myld {
+
+// lock-free open-addressing (linear probing) table which many threads fill at once with `find_or_insert()`.
+// a `Slot` has a member `std::atomic<const Key *> key`, nullptr while the slot is empty, and anything else its user
+// stores there. keys are pointers to objects which outlive the table; whether two keys are equal is told by the
+// caller. the table never grows, so it must be `reserve()`d for every key up front, and a slot stays at the same
+// address once taken
+template <typename Key, typename Slot> class ConcurrentHashTable {
+  public:
+    ConcurrentHashTable() : slots(nullptr), capacity(0) {}
+
+    // allocate the table for up to `n` distinct keys. it is at most half full
+    void reserve(u64 n) {
+        capacity = kMinCapacity;
+        while (capacity < n * 2) {
+            capacity *= 2;
+        }
+        slots = std::make_unique<Slot[]>(capacity);
+    }
+
+    // find the slot of the key `matches()` is true for, or take an empty one for `key`. `hash` is the hash of
+    // `key`. safe to call from multiple threads at once
+    template <typename Matches> Slot &find_or_insert(const Key *key, u64 hash, Matches matches) {
+        assert(capacity > 0);
+        u64 mask = capacity - 1;
+        for (u64 i = hash & mask;; i = (i + 1) & mask) {
+            Slot &slot = slots[i];
+            const Key *current = slot.key.load(std::memory_order_acquire);
+            if (current == nullptr) {
+                if (slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+                    return slot;
+                }
+                // another thread took this slot first. `current` now holds its key
+            }
+            if (matches(current)) {
+                return slot;
+            }
+        }
+    }
+
+    // the slot of the key `matches()` is true for, or nullptr if there is none
+    template <typename Matches> Slot *find(u64 hash, Matches matches) const {
+        if (capacity == 0) {
+            return nullptr;
+        }
+        u64 mask = capacity - 1;
+        for (u64 i = hash & mask;; i = (i + 1) & mask) {
+            Slot &slot = slots[i];
+            const Key *current = slot.key.load(std::memory_order_acquire);
+            if (current == nullptr) {
+                return nullptr;
+            }
+            if (matches(current)) {
+                return &slot;
+            }
+        }
+    }
+
+  private:
+    // must be a power of two
+    static constexpr u64 kMinCapacity = 1024;
+
+    std::unique_ptr<Slot[]> slots;
+    u64 capacity;
+};
+
+} // namespace Myld
+
+#endif
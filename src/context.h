@@ -2,8 +2,13 @@
 #define CONTEXT_H
 
 #include "elf-util.h"
+#include "linked-sym-table.h"
 #include "myld.h"
+#include "parallel.h"
 #include "parse-elf.h"
+#include "merge.h"
+#include "section.h"
+#include "timer.h"
 #include <cassert>
 #include <map>
 #include <optional>
@@ -11,10 +16,22 @@
 namespace Myld {
 using namespace Myld;
 
+// how --icf folds identical sections
+enum class IcfMode {
+    None,
+    // only sections whose address is never taken
+    Safe,
+    All,
+};
+
 class Config {
   public:
     Config(std::vector<std::string> input_filenames, std::string output_filename)
-        : input_filenames(input_filenames), output_filename(output_filename), text_load_addr(0x80000) {}
+        : input_filenames(input_filenames), output_filename(output_filename), text_load_addr(0x80000),
+          num_threads(Parallel::default_num_threads()), gc_sections(false), undefined_symbols({}),
+          icf(IcfMode::None), hugepage_text(false), symbol_ordering_file(std::nullopt),
+          call_graph_ordering_file(std::nullopt), call_graph_profile_sort(false), time_trace_file(std::nullopt),
+          print_stats(false) {}
 
     std::vector<std::string> get_input_filenames() const { return input_filenames; };
 
@@ -22,177 +39,229 @@ class Config {
 
     u64 get_text_load_addr() const { return text_load_addr; }
 
+    u64 get_num_threads() const { return num_threads; }
+
+    void set_num_threads(u64 n) {
+        assert(n > 0 && n <= Parallel::kMaxThreads);
+        num_threads = n;
+    }
+
+    bool get_gc_sections() const { return gc_sections; }
+
+    void set_gc_sections(bool gc_sections_) { gc_sections = gc_sections_; }
+
+    // symbols given by --undefined. they pull archive members and are roots of --gc-sections
+    std::vector<std::string> get_undefined_symbols() const { return undefined_symbols; }
+
+    void add_undefined_symbol(std::string name) { undefined_symbols.push_back(name); }
+
+    IcfMode get_icf() const { return icf; }
+
+    void set_icf(IcfMode icf_) { icf = icf_; }
+
+    bool get_hugepage_text() const { return hugepage_text; }
+
+    void set_hugepage_text(bool hugepage_text_) { hugepage_text = hugepage_text_; }
+
+    // alignment of the start of a PT_LOAD segment with `segment_flags`, both in the file and in memory.
+    // the text segment is aligned to 2 MiB with --hugepage-text so that it can be backed by transparent huge pages
+    u64 get_segment_align(u32 segment_flags) const {
+        return (hugepage_text && (segment_flags & PF_X)) ? kHugePageSize : kPageSize;
+    }
+
+    // file listing symbols, one per line, whose sections are placed first in this order
+    std::optional<std::string> get_symbol_ordering_file() const { return symbol_ordering_file; }
+
+    void set_symbol_ordering_file(std::string filename) { symbol_ordering_file = filename; }
+
+    // file of call graph edges, one "caller callee count" per line (e.g. counted from `perf record` samples)
+    std::optional<std::string> get_call_graph_ordering_file() const { return call_graph_ordering_file; }
+
+    void set_call_graph_ordering_file(std::string filename) { call_graph_ordering_file = filename; }
+
+    // whether sections are sorted by the .llvm.call-graph-profile sections of the inputs
+    bool get_call_graph_profile_sort() const { return call_graph_profile_sort; }
+
+    void set_call_graph_profile_sort(bool call_graph_profile_sort_) { call_graph_profile_sort = call_graph_profile_sort_; }
+
+    // where the Chrome trace of --time-trace is written. nullopt without --time-trace
+    std::optional<std::string> get_time_trace_file() const { return time_trace_file; }
+
+    void set_time_trace_file(std::string filename) { time_trace_file = filename; }
+
+    bool get_print_stats() const { return print_stats; }
+
+    void set_print_stats(bool print_stats_) { print_stats = print_stats_; }
+
+    static constexpr u64 kPageSize = 0x1000;
+    static constexpr u64 kHugePageSize = 0x200000;
+
   private:
     std::vector<std::string> input_filenames;
     std::string output_filename;
     u64 text_load_addr;
+    // size of the worker pool. 1 means everything runs on the main thread
+    u64 num_threads;
+    bool gc_sections;
+    std::vector<std::string> undefined_symbols;
+    IcfMode icf;
+    bool hugepage_text;
+    std::optional<std::string> symbol_ordering_file;
+    std::optional<std::string> call_graph_ordering_file;
+    bool call_graph_profile_sort;
+    std::optional<std::string> time_trace_file;
+    bool print_stats;
 };
 
-class LinkedSymTableEntry {
+class Context {
   public:
-    LinkedSymTableEntry(std::string name, std::vector<u8> bytes, std::string obj_file_name)
-        : name(name), bytes(bytes), obj_file_name(obj_file_name) {
-        // check data size
-        assert(bytes.size() == sizeof(Elf64_Sym));
-    }
+    Context(Config config) : objs({}), config(config), _start_addr(std::nullopt), got_section(nullptr) {}
 
-    static LinkedSymTableEntry from(std::shared_ptr<Parse::SymTableEntry> entry, std::string obj_file_name) {
-        LinkedSymTableEntry linked_sym(entry->get_name(), entry->get_raw().to_vec(), obj_file_name);
-        // name indexは意味をなさなくなるので0にセットしておく
-        linked_sym.get_sym()->st_name = 0;
-        return linked_sym;
+    void init() {
+        linked_sym_table.init();
+        if (config.get_time_trace_file().has_value() || config.get_print_stats()) {
+            time_trace.enable();
+        }
     }
 
-    std::string get_name() const { return name; }
+    std::vector<std::shared_ptr<Myld::Parse::Elf>> objs;
+    Config config;
+    LinkedSymTable linked_sym_table;
+
+    // timers only record, so they also run in passes which take a const context
+    mutable TimeTrace time_trace;
+    Stats stats;
+
+    // resolved address of `_start`
+    std::optional<u64> _start_addr;
+
+    // output sections in the order they are placed in memory
+    std::vector<std::shared_ptr<OutputSection>> output_sections;
 
-    std::string get_obj_file_name() const { return obj_file_name; }
+    // input sections which are part of the output, indexed by [object index][section index].
+    // nullptr if the section is not laid out
+    std::vector<std::vector<std::shared_ptr<InputSection>>> input_sections;
 
-    // clone and return its raw data
-    std::vector<u8> get_bytes() const { return std::vector<u8>(bytes); }
+    // whether each section is reachable from the gc roots, indexed by [object index][section index].
+    // every section is live without --gc-sections
+    std::vector<std::vector<bool>> live_sections;
 
-    Elf64_Sym *get_sym() {
-        // maybe unsafe operation?
-        return (Elf64_Sym *)(&bytes[0]);
+    bool is_live(u64 obj_index, u64 shndx) const {
+        // special section indexes (SHN_ABS, SHN_COMMON, ...) are never removed
+        return shndx >= live_sections[obj_index].size() || live_sections[obj_index][shndx];
     }
 
-    u8 get_bind() const { return ELF64_ST_BIND(get_const_sym()->st_info); }
+    // sections folded by --icf. (object index, section index) -> the identical section which is kept
+    std::map<std::pair<u32, u32>, std::pair<u32, u32>> folded_sections;
 
-    u8 get_type() const { return ELF64_ST_TYPE(get_const_sym()->st_info); }
+    bool is_folded(u32 obj_index, u32 shndx) const {
+        return folded_sections.contains(std::make_pair(obj_index, shndx));
+    }
 
-  private:
-    std::string name;
-    std::vector<u8> bytes;
-    // "" in case of null symbol
-    std::string obj_file_name;
-
-    const Elf64_Sym *get_const_sym() const {
-        // maybe unsafe operation?
-        return (Elf64_Sym *)(&bytes[0]);
+    // place of input sections in their output section, (object index, section index) -> priority. lower comes
+    // first. set by `order_sections()`; sections without a priority follow in input order
+    std::map<std::pair<u32, u32>, u64> section_priorities;
+    static constexpr u64 kNoPriority = UINT64_MAX;
+
+    u64 get_section_priority(u32 obj_index, u32 shndx) const {
+        auto iter = section_priorities.find(std::make_pair(obj_index, shndx));
+        return iter == section_priorities.end() ? kNoPriority : iter->second;
     }
-};
 
-// class represents a new symbol table whose symbols are gathered from multiple object files
-class LinkedSymTable {
-  public:
-    LinkedSymTable() : entries({}) {}
+    // SHF_MERGE sections whose contents are merged, indexed by [object index][section index]. nullptr for others
+    std::vector<std::vector<std::shared_ptr<MergeableSection>>> mergeable_sections;
+    std::vector<std::shared_ptr<MergedSection>> merged_sections;
 
-    std::map<std::string, std::shared_ptr<LinkedSymTableEntry>> get_entries() const { return entries; }
+    MergeableSection *get_mergeable_section(u64 obj_index, u64 shndx) const {
+        if (obj_index >= mergeable_sections.size() || shndx >= mergeable_sections[obj_index].size()) {
+            return nullptr;
+        }
+        return mergeable_sections[obj_index][shndx].get();
+    }
 
-    // initialize symbol table. Especially, push null symbol to the table
-    void init() {
-        // push null symbol as the first symbol
-        auto null_sym_bytes = std::vector<u8>(to_bytes(Utils::create_null_sym()));
-        LinkedSymTableEntry null_sym = LinkedSymTableEntry("", null_sym_bytes, "");
-        insert(std::make_shared<LinkedSymTableEntry>(null_sym));
+    // address in the output of the byte at `offset` of a merged input section
+    u64 get_merged_addr(u64 obj_index, u64 shndx, u64 offset) const {
+        MergeableSection *mergeable_section = get_mergeable_section(obj_index, shndx);
+        assert(mergeable_section != nullptr);
+        return mergeable_section->get_parent()->get_output_section()->get_addr() +
+               mergeable_section->get_output_offset(offset);
     }
 
-    bool insert(std::shared_ptr<LinkedSymTableEntry> sym_entry) {
-        // TODO: elaborate
-        bool ret = entries.find(sym_entry->get_name()) == entries.end();
-        entries.insert(std::make_pair(sym_entry->get_name(), sym_entry));
-        return ret;
+    std::shared_ptr<InputSection> get_input_section(u64 obj_index, u64 shndx) const {
+        assert(obj_index < input_sections.size() && shndx < input_sections[obj_index].size());
+        return input_sections[obj_index][shndx];
     }
 
-    std::shared_ptr<LinkedSymTableEntry> get_symbol_by_name(std::string name) const {
-        if (entries.find(name) == entries.end()) {
-            return nullptr;
-        } else {
-            return entries.at(name);
-        }
+    std::shared_ptr<InputSection> create_input_section(u64 obj_index, u64 shndx) {
+        auto input_section = std::make_shared<InputSection>(objs[obj_index], obj_index, shndx);
+        input_sections[obj_index][shndx] = input_section;
+        return input_section;
     }
 
-    // convert to .symtab section data
-    std::vector<u8> to_symtab_section_body() {
-        u64 name_index = 0;
-        std::vector<u8> bytes;
-        bytes.reserve(entries.size() * sizeof(Elf64_Sym));
-        for (int i = 0; i < 2; i++) {
-            for (auto entry : entries) {
-                // To locate FILE symbols front of symbol table entry, we take the following measure:
-                // We scan entries linearly twice.
-                // In first scan, only looks for FILE
-                // In second scan. looks for other symbols
-                // FIXME: buggy. 単純にエントリーをtypeでソートするほうがいい
-                if (i == 0 && entry.second->get_type() != STT_FILE) {
-                    continue;
-                } else if (i == 1 && entry.second->get_type() == STT_FILE) {
-                    continue;
-                }
-
-                // set name index
-                entry.second->get_sym()->st_name = name_index;
-                std::vector<u8> entry_bytes = entry.second->get_bytes();
-                bytes.insert(bytes.end(), entry_bytes.begin(), entry_bytes.end());
-                // update name index (plus 1 because of "\0")
-                name_index += entry.second->get_name().length() + 1;
+    std::shared_ptr<OutputSection> get_output_section(std::string name) const {
+        for (auto &output_section : output_sections) {
+            if (output_section->get_name() == name) {
+                return output_section;
             }
         }
-        return bytes;
+        return nullptr;
     }
 
-    // convert to .strtab section data
-    // これを呼んだあとに、シンボルを追加すると.strtabの一貫性が失われる
-    std::vector<u8> to_strtab_section_body() {
-        std::vector<u8> bytes;
-        bytes.reserve(entries.size() * sizeof(Elf64_Sym));
-        for (int i = 0; i < 2; i++) {
-            for (auto entry : entries) {
-                // To locate FILE symbols front of symbol table entry, we take the following measure:
-                // We scan entries linearly twice.
-                // In first scan, only looks for FILE
-                // In second scan. looks for other symbols
-                // FIXME: buggy. 単純にエントリーをtypeでソートするほうがいい
-                if (i == 0 && entry.second->get_type() != STT_FILE) {
-                    continue;
-                } else if (i == 1 && entry.second->get_type() == STT_FILE) {
-                    continue;
-                }
-
-                std::string name = entry.second->get_name();
-                bytes.insert(bytes.end(), name.begin(), name.end());
-                bytes.push_back('\0');
-            }
+    // get the output section named `name`. it is created at the end of the output if it does not exist yet
+    std::shared_ptr<OutputSection> get_or_create_output_section(std::string name, u32 type, u64 flags, u64 align) {
+        if (auto output_section = get_output_section(name); output_section != nullptr) {
+            return output_section;
         }
-        return bytes;
+        output_sections.push_back(std::make_shared<OutputSection>(name, type, flags, align));
+        return output_sections.back();
     }
 
-    u64 get_local_symbol_num() const {
-        u64 ret = 0;
-        for (auto entry : entries) {
-            if (entry.second->get_bind() == STB_LOCAL) {
-                ret++;
+    // COMMON symbols which won resolution, as (symbol id, offset in .bss), in id order
+    std::vector<std::pair<SymbolId, u64>> common_symbols;
+
+    // synthetic .got section. nullptr if no relocation needs the GOT
+    std::shared_ptr<OutputSection> got_section;
+
+    // index of the .got entry of each symbol, indexed by `SymbolId`. `kNoGotEntry` if the symbol has none
+    std::vector<u32> got_entries;
+    static constexpr u32 kNoGotEntry = UINT32_MAX;
+
+    // index of the .got entry of each symbol which has no `SymbolId` (section symbols and undefined weak symbols),
+    // keyed by (object index, symbol index)
+    std::map<std::pair<u64, u64>, u32> unnamed_got_entries;
+
+    // address of the .got entry which holds the address of the `sym_index`-th symbol of the `obj_index`-th object
+    std::optional<u64> get_got_entry_addr(u64 obj_index, u64 sym_index) const {
+        SymbolId id = objs[obj_index]->get_symbol_id(sym_index);
+        if (id == kInvalidSymbolId) {
+            auto it = unnamed_got_entries.find(std::make_pair(obj_index, sym_index));
+            if (it == unnamed_got_entries.end()) {
+                return std::nullopt;
             }
+            return got_section->get_addr() + it->second * sizeof(u64);
+        }
+        if (id >= got_entries.size() || got_entries[id] == kNoGotEntry) {
+            return std::nullopt;
         }
-        return ret;
+        return got_section->get_addr() + got_entries[id] * sizeof(u64);
     }
 
-  private:
-    // map from symbol name to symbol
-    std::map<std::string, std::shared_ptr<LinkedSymTableEntry>> entries;
-};
+    void build_and_output();
 
-class Context {
-  public:
-    Context(std::vector<std::string> input_filenames, std::string output_filename)
-        : objs({}), config(Config(input_filenames, output_filename)), layout(), _start_addr(std::nullopt) {}
+    void parse_objects();
 
-    void init() {
-        linked_sym_table.init();
-    }
+    void resolve_symbols();
 
-    std::vector<std::shared_ptr<Myld::Parse::Elf>> objs;
-    Config config;
-    LinkedSymTable linked_sym_table;
-    std::map<ObjAndSection, u64> layout;
+    void mark_live_sections();
 
-    // resolved address of `_start`
-    std::optional<u64> _start_addr;
+    void fold_identical_sections();
 
-    std::map<std::string, std::vector<u8>> section_raws;
+    void merge_sections();
 
-    void build_and_output();
+    void order_sections();
 
-    void parse_objects();
+    // print the summary of --stats
+    void print_stats() const;
 };
 
 } // namespace Myld
@@ -2,6 +2,7 @@
 #define ELF_UTIL_H
 
 #include "myld.h"
+#include <cassert>
 #include <elf.h>
 #include <memory>
 
@@ -59,15 +60,15 @@ static void finalize_eheader(Elf64_Ehdr *eheader, Elf64_Addr entry_point_addr, u
     eheader->e_shstrndx = shstrtab_index;
 }
 
-static Elf64_Phdr create_dummy_pheader_load(u64 vaddr, u64 paddr, u64 align) {
+// PT_LOAD segment starting at `offset` of the file and at `vaddr` in memory. the size is set by
+// `finalize_pheader_load()`
+static Elf64_Phdr create_dummy_pheader_load(u32 flags, u64 offset, u64 vaddr, u64 align) {
     Elf64_Phdr program_header_entry_load = Elf64_Phdr{
         .p_type = PT_LOAD,
-        // TODO: ldは特定のセクションの有無に応じて変えている
-        // e.g. ldでは .textのみならRX. .text & .rodataならRWX.
-        .p_flags = PF_R | PF_W | PF_X,
-        .p_offset = DUMMY,
+        .p_flags = flags,
+        .p_offset = offset,
         .p_vaddr = vaddr,
-        .p_paddr = paddr,
+        .p_paddr = vaddr,
         .p_filesz = DUMMY,
         .p_memsz = DUMMY,
         .p_align = align,
@@ -75,10 +76,11 @@ static Elf64_Phdr create_dummy_pheader_load(u64 vaddr, u64 paddr, u64 align) {
     return program_header_entry_load;
 }
 
-static void finalize_pheader_load(Elf64_Phdr *pheader, u64 offset, u64 size) {
-    pheader->p_offset = offset;
-    pheader->p_filesz = size; // TODO: correct?
-    pheader->p_memsz = size;  // TODO: correct>
+// `memsz` is larger than `filesz` when the segment ends with SHT_NOBITS sections (e.g. .bss)
+static void finalize_pheader_load(Elf64_Phdr *pheader, u64 filesz, u64 memsz) {
+    assert(filesz <= memsz);
+    pheader->p_filesz = filesz;
+    pheader->p_memsz = memsz;
 }
 
 static std::shared_ptr<Elf64_Shdr> create_dummy_sheader(u32 name, u32 type, u64 flags, u64 addr, u32 link, u32 info,
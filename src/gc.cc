@@ -0,0 +1,116 @@
+#include "context.h"
+#include "parallel.h"
+#include <atomic>
+
+namespace Myld {
+
+#ifndef SHF_GNU_RETAIN
+#define SHF_GNU_RETAIN (1 << 21)
+#endif
+
+// sections which must be kept even if nothing refers to them (KEEP() in the default linker script of GNU ld)
+static bool is_gc_root(const Parse::Section &section) {
+    const Elf64_Shdr *header = section.get_header();
+    if (header->sh_flags & SHF_GNU_RETAIN) {
+        return true;
+    }
+    if (header->sh_type == SHT_INIT_ARRAY || header->sh_type == SHT_FINI_ARRAY ||
+        header->sh_type == SHT_PREINIT_ARRAY || header->sh_type == SHT_NOTE) {
+        return true;
+    }
+    std::string_view name = section.get_name();
+    return name == ".init" || name == ".fini" || name.starts_with(".ctors") || name.starts_with(".dtors");
+}
+
+void Context::mark_live_sections() {
+    live_sections.resize(objs.size());
+    if (!config.get_gc_sections()) {
+        for (u64 i = 0; i < objs.size(); i++) {
+            live_sections[i] = std::vector<bool>(objs[i]->get_section_num(), true);
+        }
+        return;
+    }
+
+    std::vector<std::unique_ptr<std::atomic<bool>[]>> marks(objs.size());
+    for (u64 i = 0; i < objs.size(); i++) {
+        marks[i] = std::make_unique<std::atomic<bool>[]>(objs[i]->get_section_num());
+    }
+
+    // (object index, section index) of sections which are marked but whose relocations are not followed yet
+    typedef std::pair<u32, u32> SectionRef;
+    auto try_mark = [&](u32 obj_index, u64 shndx, std::vector<SectionRef> &worklist) {
+        if (shndx == SHN_UNDEF || shndx >= SHN_LORESERVE || shndx >= objs[obj_index]->get_section_num()) {
+            return;
+        }
+        if (!marks[obj_index][shndx].exchange(true, std::memory_order_relaxed)) {
+            worklist.push_back(SectionRef(obj_index, shndx));
+        }
+    };
+
+    // roots: the entry point, symbols given by --undefined and sections which must be kept
+    std::vector<SectionRef> frontier;
+    std::vector<std::string> root_symbols = config.get_undefined_symbols();
+    root_symbols.push_back("_start");
+    for (auto &name : root_symbols) {
+        SymbolId id = linked_sym_table.find(name);
+        if (id != kInvalidSymbolId && linked_sym_table.get_obj_index(id) != kNoObjIndex) {
+            try_mark(linked_sym_table.get_obj_index(id), linked_sym_table.get_shndx(id), frontier);
+        }
+    }
+    for (u64 i = 0; i < objs.size(); i++) {
+        for (u64 shndx = 0; shndx < objs[i]->get_section_num(); shndx++) {
+            auto section = objs[i]->get_section(shndx);
+            // sections which are not loaded are not subject to gc, but their relocations (e.g. debug info) do not
+            // keep anything alive either
+            if (!(section->get_header()->sh_flags & SHF_ALLOC)) {
+                marks[i][shndx].store(true, std::memory_order_relaxed);
+            } else if (is_unwind_section(*section)) {
+                // unwind tables are kept as GNU ld does, but a FDE does not keep its function alive: their
+                // relocations are not followed. FDEs of removed functions are left pointing at address 0
+                marks[i][shndx].store(true, std::memory_order_relaxed);
+            } else if (is_gc_root(*section)) {
+                try_mark(i, shndx, frontier);
+            }
+        }
+    }
+
+    // follow relocations breadth first. sections of one level are scanned in parallel
+    while (!frontier.empty()) {
+        std::vector<std::vector<SectionRef>> next(frontier.size());
+        Parallel::parallel_for(config.get_num_threads(), frontier.size(), [&](u64 i) {
+            auto [obj_index, shndx] = frontier[i];
+            const Parse::Elf &obj = *objs[obj_index];
+            auto rela = obj.get_rela(shndx);
+            if (rela == nullptr) {
+                return;
+            }
+            auto &sym_entries = obj.get_sym_table()->get_entries();
+            for (auto &rela_entry : rela->get_entries()) {
+                const Parse::SymTableEntry &sym = sym_entries[rela_entry.get_sym()];
+                if (sym.get_bind() == STB_LOCAL) {
+                    try_mark(obj_index, sym.get_sym()->st_shndx, next[i]);
+                    continue;
+                }
+                SymbolId id = obj.get_symbol_id(rela_entry.get_sym());
+                if (id == kInvalidSymbolId) {
+                    continue;
+                }
+                try_mark(linked_sym_table.get_obj_index(id), linked_sym_table.get_shndx(id), next[i]);
+            }
+        });
+
+        frontier.clear();
+        for (auto &refs : next) {
+            frontier.insert(frontier.end(), refs.begin(), refs.end());
+        }
+    }
+
+    for (u64 i = 0; i < objs.size(); i++) {
+        live_sections[i].resize(objs[i]->get_section_num());
+        for (u64 shndx = 0; shndx < objs[i]->get_section_num(); shndx++) {
+            live_sections[i][shndx] = marks[i][shndx].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+} // namespace Myld
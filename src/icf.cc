@@ -0,0 +1,257 @@
+#include "context.h"
+#include "log.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <numeric>
+#include <tuple>
+
+namespace Myld {
+
+// what a relocation of a folding candidate points to
+struct IcfTarget {
+    // index in the candidate list if the target section is a candidate too, otherwise kNoCandidate
+    u32 candidate;
+    // defining object and section of the target, or (kNoObjIndex, symbol id) for symbols without a section
+    u32 obj_index;
+    u32 shndx;
+    // offset in the target section
+    u64 value;
+};
+
+struct IcfReloc {
+    u64 offset;
+    u32 type;
+    i64 addend;
+    IcfTarget target;
+};
+
+// a section which may be folded
+struct IcfCandidate {
+    u32 obj_index;
+    u32 shndx;
+    Raw raw;
+    u64 align;
+    std::vector<IcfReloc> relocs;
+    // hash of everything but the classes of candidate targets
+    u64 hash;
+};
+
+static constexpr u32 kNoCandidate = UINT32_MAX;
+
+static u64 hash_combine(u64 hash, u64 value) { return (hash ^ value) * 0x100000001b3; }
+
+static bool is_icf_candidate(const Parse::Section &section) {
+    const Elf64_Shdr *header = section.get_header();
+    std::string_view name = section.get_name();
+    return header->sh_type == SHT_PROGBITS && header->sh_size > 0 && (header->sh_flags & SHF_ALLOC) &&
+           (header->sh_flags & SHF_EXECINSTR) && !(header->sh_flags & SHF_WRITE) &&
+           (name == ".text" || name.starts_with(".text."));
+}
+
+// target of the `sym_index`-th symbol of the `obj_index`-th object
+static IcfTarget get_icf_target(const Context &ctx, u32 obj_index, u32 sym_index) {
+    const Parse::Elf &obj = *ctx.objs[obj_index];
+    const Parse::SymTableEntry &sym = obj.get_sym_table()->get_entries()[sym_index];
+    if (sym.get_bind() == STB_LOCAL) {
+        return IcfTarget{kNoCandidate, obj_index, sym.get_sym()->st_shndx, sym.get_sym()->st_value};
+    }
+    SymbolId id = obj.get_symbol_id(sym_index);
+    if (id == kInvalidSymbolId) {
+        return IcfTarget{kNoCandidate, kNoObjIndex, kInvalidSymbolId, 0};
+    }
+    u16 shndx = ctx.linked_sym_table.get_shndx(id);
+    if (shndx == SHN_UNDEF || shndx >= SHN_LORESERVE) {
+        return IcfTarget{kNoCandidate, kNoObjIndex, id, 0};
+    }
+    return IcfTarget{kNoCandidate, ctx.linked_sym_table.get_obj_index(id), shndx, ctx.linked_sym_table.get_value(id)};
+}
+
+// whether two candidates are equal apart from the classes of candidate targets
+static bool icf_less(const IcfCandidate &a, const IcfCandidate &b) {
+    if (a.hash != b.hash) {
+        return a.hash < b.hash;
+    }
+    if (a.raw.get_size() != b.raw.get_size()) {
+        return a.raw.get_size() < b.raw.get_size();
+    }
+    if (a.align != b.align) {
+        return a.align < b.align;
+    }
+    if (int cmp = std::memcmp(a.raw.begin(), b.raw.begin(), a.raw.get_size()); cmp != 0) {
+        return cmp < 0;
+    }
+    if (a.relocs.size() != b.relocs.size()) {
+        return a.relocs.size() < b.relocs.size();
+    }
+    for (u64 i = 0; i < a.relocs.size(); i++) {
+        const IcfReloc &x = a.relocs[i];
+        const IcfReloc &y = b.relocs[i];
+        auto key = [](const IcfReloc &r) {
+            bool to_candidate = r.target.candidate != kNoCandidate;
+            // candidate targets are compared by class later
+            return std::make_tuple(r.offset, r.type, r.addend, to_candidate, to_candidate ? 0 : r.target.obj_index,
+                                   to_candidate ? 0 : r.target.shndx, r.target.value);
+        };
+        if (key(x) != key(y)) {
+            return key(x) < key(y);
+        }
+    }
+    return false;
+}
+
+// give the same class to each run of equal elements of `order`. returns the number of classes
+template <typename Less> static u32 assign_classes(const std::vector<u32> &order, std::vector<u32> &classes, Less less) {
+    u32 class_num = 0;
+    for (u64 i = 0; i < order.size(); i++) {
+        if (i == 0 || less(order[i - 1], order[i])) {
+            class_num++;
+        }
+        classes[order[i]] = class_num - 1;
+    }
+    return class_num;
+}
+
+void Context::fold_identical_sections() {
+    if (config.get_icf() == IcfMode::None) {
+        return;
+    }
+    u64 num_threads = config.get_num_threads();
+
+    // with --icf=safe, sections whose address may be observed are not folded. only calls (PLT32) and unwind tables
+    // do not take the address of a function
+    std::vector<std::unique_ptr<std::atomic<bool>[]>> address_taken(objs.size());
+    for (u64 i = 0; i < objs.size(); i++) {
+        address_taken[i] = std::make_unique<std::atomic<bool>[]>(objs[i]->get_section_num());
+    }
+    if (config.get_icf() == IcfMode::Safe) {
+        Parallel::parallel_for(num_threads, objs.size(), [&](u64 i) {
+            auto obj = objs[i];
+            for (u64 shndx = 0; shndx < obj->get_section_num(); shndx++) {
+                auto rela = obj->get_rela(shndx);
+                if (rela == nullptr || !is_live(i, shndx) ||
+                    !(obj->get_section(shndx)->get_header()->sh_flags & SHF_ALLOC) ||
+                    is_unwind_section(*obj->get_section(shndx))) {
+                    continue;
+                }
+                for (auto &rela_entry : rela->get_entries()) {
+                    if (rela_entry.get_type() == R_X86_64_PLT32) {
+                        continue;
+                    }
+                    IcfTarget target = get_icf_target(*this, i, rela_entry.get_sym());
+                    if (target.obj_index != kNoObjIndex && target.shndx < objs[target.obj_index]->get_section_num()) {
+                        address_taken[target.obj_index][target.shndx].store(true, std::memory_order_relaxed);
+                    }
+                }
+            }
+        });
+        for (auto &name : config.get_undefined_symbols()) {
+            SymbolId id = linked_sym_table.find(name);
+            if (id == kInvalidSymbolId || linked_sym_table.get_obj_index(id) == kNoObjIndex) {
+                continue;
+            }
+            u32 obj_index = linked_sym_table.get_obj_index(id);
+            u16 shndx = linked_sym_table.get_shndx(id);
+            if (shndx < objs[obj_index]->get_section_num()) {
+                address_taken[obj_index][shndx] = true;
+            }
+        }
+    }
+
+    // collect candidates
+    std::vector<IcfCandidate> candidates;
+    std::vector<std::vector<u32>> candidate_index(objs.size());
+    for (u64 i = 0; i < objs.size(); i++) {
+        candidate_index[i] = std::vector<u32>(objs[i]->get_section_num(), kNoCandidate);
+        for (u64 shndx = 0; shndx < objs[i]->get_section_num(); shndx++) {
+            auto section = objs[i]->get_section(shndx);
+            if (is_live(i, shndx) && is_icf_candidate(*section) && !address_taken[i][shndx]) {
+                candidate_index[i][shndx] = candidates.size();
+                candidates.push_back(IcfCandidate{(u32)i, (u32)shndx, section->get_raw(),
+                                                  section->get_header()->sh_addralign, {}, 0});
+            }
+        }
+    }
+    if (candidates.size() < 2) {
+        return;
+    }
+
+    // hash contents and relocations in parallel
+    Parallel::parallel_for(num_threads, candidates.size(), [&](u64 c) {
+        IcfCandidate &candidate = candidates[c];
+        const Parse::Elf &obj = *objs[candidate.obj_index];
+        if (auto rela = obj.get_rela(candidate.shndx); rela != nullptr) {
+            for (auto &rela_entry : rela->get_entries()) {
+                const Elf64_Rela *r = rela_entry.get_rela();
+                IcfTarget target = get_icf_target(*this, candidate.obj_index, rela_entry.get_sym());
+                if (target.obj_index != kNoObjIndex && target.shndx < candidate_index[target.obj_index].size()) {
+                    target.candidate = candidate_index[target.obj_index][target.shndx];
+                }
+                candidate.relocs.push_back(IcfReloc{r->r_offset, rela_entry.get_type(), r->r_addend, target});
+            }
+            std::sort(candidate.relocs.begin(), candidate.relocs.end(),
+                      [](const IcfReloc &a, const IcfReloc &b) { return a.offset < b.offset; });
+        }
+
+        u64 hash = hash_string(std::string_view((const char *)candidate.raw.begin(), candidate.raw.get_size()));
+        hash = hash_combine(hash, candidate.align);
+        for (auto &reloc : candidate.relocs) {
+            hash = hash_combine(hash, reloc.offset);
+            hash = hash_combine(hash, reloc.type);
+            hash = hash_combine(hash, reloc.addend);
+            hash = hash_combine(hash, reloc.target.value);
+            if (reloc.target.candidate == kNoCandidate) {
+                hash = hash_combine(hash, ((u64)reloc.target.obj_index << 32) | reloc.target.shndx);
+            }
+        }
+        candidate.hash = hash;
+    });
+
+    // initial classes: candidates equal apart from the classes of the sections they refer to
+    std::vector<u32> order(candidates.size());
+    std::iota(order.begin(), order.end(), 0);
+    auto static_less = [&](u32 a, u32 b) { return icf_less(candidates[a], candidates[b]); };
+    std::sort(order.begin(), order.end(), static_less);
+    std::vector<u32> classes(candidates.size());
+    u32 class_num = assign_classes(order, classes, static_less);
+
+    // refine the classes until they stop changing: two candidates stay in a class only if their candidate targets
+    // are in the same classes
+    std::vector<std::vector<u32>> keys(candidates.size());
+    while (true) {
+        Parallel::parallel_for(num_threads, candidates.size(), [&](u64 c) {
+            keys[c].clear();
+            keys[c].push_back(classes[c]);
+            for (auto &reloc : candidates[c].relocs) {
+                if (reloc.target.candidate != kNoCandidate) {
+                    keys[c].push_back(classes[reloc.target.candidate]);
+                }
+            }
+        });
+        auto key_less = [&](u32 a, u32 b) { return keys[a] < keys[b]; };
+        std::sort(order.begin(), order.end(), key_less);
+        u32 new_class_num = assign_classes(order, classes, key_less);
+        if (new_class_num == class_num) {
+            break;
+        }
+        class_num = new_class_num;
+    }
+
+    // fold each class into its first member in input order
+    std::vector<u32> leaders(class_num, kNoCandidate);
+    u64 folded_size = 0;
+    for (u32 c = 0; c < candidates.size(); c++) {
+        if (leaders[classes[c]] == kNoCandidate) {
+            leaders[classes[c]] = c;
+            continue;
+        }
+        const IcfCandidate &leader = candidates[leaders[classes[c]]];
+        folded_sections[std::make_pair(candidates[c].obj_index, candidates[c].shndx)] =
+            std::make_pair(leader.obj_index, leader.shndx);
+        folded_size += candidates[c].raw.get_size();
+    }
+    MYLD_INFO("icf: folded {} sections ({} bytes)\n", folded_sections.size(), folded_size);
+}
+
+} // namespace Myld
@@ -0,0 +1,289 @@
+#ifndef LINKED_SYM_TABLE_H
+#define LINKED_SYM_TABLE_H
+
+#include "concurrent-hash-table.h"
+#include "elf-util.h"
+#include "myld.h"
+#include "parallel.h"
+#include "parse-elf.h"
+#include "string-table.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <elf.h>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Myld {
+
+// value of `LinkedSymTable::get_obj_index()` for symbols which do not come from an object file
+static constexpr u32 kNoObjIndex = UINT32_MAX;
+
+// class represents a new symbol table whose symbols are gathered from multiple object files.
+// every symbol gets a stable `SymbolId`, which relocations refer to.
+// symbols are stored as parallel arrays indexed by `SymbolId`, one array per field, so that a pass over all symbols
+// only reads the fields it needs from contiguous memory.
+//
+// global symbols are resolved concurrently through a lock-free open-addressing hash table keyed by name.
+// every definition `claim()`s its name with a rank; the smallest rank wins, so the chosen definition depends only
+// on input order, never on thread timing. ids are handed out afterwards with `resize()` and `set_symbol()`
+class LinkedSymTable {
+  public:
+    LinkedSymTable() {}
+
+    u64 get_symbol_num() const { return names.size(); }
+
+    // a view into the string table of the input file. it lives as long as the file
+    std::string_view get_name(SymbolId id) const { return names[id]; }
+
+    // st_value. an offset in its section until addresses are resolved, the address afterwards
+    u64 get_value(SymbolId id) const { return values[id]; }
+
+    void set_value(SymbolId id, u64 value) { values[id] = value; }
+
+    u64 get_size(SymbolId id) const { return sizes[id]; }
+
+    void set_size(SymbolId id, u64 size) { sizes[id] = size; }
+
+    // st_shndx, a section index of the defining object file
+    u16 get_shndx(SymbolId id) const { return shndxs[id]; }
+
+    u8 get_bind(SymbolId id) const { return ELF64_ST_BIND(infos[id]); }
+
+    u8 get_type(SymbolId id) const { return ELF64_ST_TYPE(infos[id]); }
+
+    // index of the defining object file in `Context::objs`. `kNoObjIndex` in case of null symbol
+    u32 get_obj_index(SymbolId id) const { return obj_indexes[id]; }
+
+    // the symbol as an entry of the output .symtab, whose name is at `name_offset` of the output .strtab and which is
+    // defined in the `shndx`-th section of the output
+    Elf64_Sym get_elf_sym(SymbolId id, u32 name_offset, u16 shndx) const {
+        Elf64_Sym sym;
+        sym.st_name = name_offset;
+        sym.st_info = infos[id];
+        sym.st_other = others[id];
+        sym.st_shndx = shndx;
+        sym.st_value = values[id];
+        sym.st_size = sizes[id];
+        return sym;
+    }
+
+    // initialize symbol table. Especially, push null symbol to the table
+    void init() {
+        assert(get_symbol_num() == 0);
+        // push null symbol as the first symbol
+        resize(1);
+        set_fields(kNullSymbolId, "", Utils::create_null_sym(), kNoObjIndex);
+    }
+
+    // allocate the hash table for up to `n` distinct global names.
+    // must be called before `claim()`; the table never grows while threads are inserting
+    void reserve(u64 n) { slots.reserve(n); }
+
+    // rank of a definition. lower is preferred: strong definitions beat COMMON symbols, which beat weak ones, then
+    // earlier input files win
+    static u64 make_rank(bool is_weak, bool is_common, u64 file_index, u64 sym_index) {
+        assert(file_index < (1ULL << 30) && sym_index < (1ULL << 32));
+        return ((u64)is_weak << 63) | ((u64)is_common << 62) | (file_index << 32) | sym_index;
+    }
+
+    static bool rank_is_weak(u64 rank) { return (rank >> 63) != 0; }
+
+    static bool rank_is_common(u64 rank) { return ((rank >> 62) & 1) != 0; }
+
+    static u64 rank_file_index(u64 rank) { return (rank >> 32) & ((1ULL << 30) - 1); }
+
+    // insert-or-resolve a global definition. safe to call from multiple threads at once
+    void claim(const Parse::SymTableEntry *sym, u64 rank) {
+        u64 hash = sym->get_name_hash();
+        Slot &slot = slots.find_or_insert(
+            sym, hash, [&](const Parse::SymTableEntry *key) { return key_matches(key, sym->get_name(), hash); });
+        u64 current = slot.rank.load(std::memory_order_relaxed);
+        while (rank < current && !slot.rank.compare_exchange_weak(current, rank, std::memory_order_relaxed)) {
+        }
+    }
+
+    // rank of the winning definition of `name`, or `kNoRank` if `name` is not defined
+    u64 get_rank(std::string_view name, u64 hash) const {
+        const Slot *slot = find_slot(name, hash);
+        return slot == nullptr ? kNoRank : slot->rank.load(std::memory_order_relaxed);
+    }
+
+    // make room for ids [0, n). ids are assigned by the caller so that they follow input order
+    void resize(u64 n) {
+        assert(n >= get_symbol_num());
+        names.resize(n);
+        values.resize(n);
+        sizes.resize(n);
+        shndxs.resize(n);
+        infos.resize(n);
+        others.resize(n);
+        obj_indexes.resize(n, kNoObjIndex);
+    }
+
+    // store the symbol `sym` of the object file `obj_index` as id `id`. different ids may be set from different
+    // threads. a global symbol must be the winner of its name
+    void set_symbol(SymbolId id, const Parse::SymTableEntry &sym, u32 obj_index) {
+        assert(id < get_symbol_num() && obj_indexes[id] == kNoObjIndex);
+        set_fields(id, sym.get_name(), *sym.get_sym(), obj_index);
+        if (sym.get_bind() != STB_LOCAL) {
+            Slot *slot = find_slot(sym.get_name(), sym.get_name_hash());
+            assert(slot != nullptr);
+            slot->id = id;
+        }
+    }
+
+    // look up a global symbol. returns `kInvalidSymbolId` if not found
+    SymbolId find(std::string_view name, u64 hash) const {
+        const Slot *slot = find_slot(name, hash);
+        return slot == nullptr ? kInvalidSymbolId : slot->id;
+    }
+
+    SymbolId find(std::string_view name) const { return find(name, hash_string(name)); }
+
+    static constexpr u64 kNoRank = UINT64_MAX;
+
+    // value of an output section index given to `layout_output()` for symbols which are left out of the output
+    static constexpr u32 kDropSymbol = UINT32_MAX;
+
+    // decide where each symbol goes in the output .symtab and where its name is in the output .strtab. local
+    // symbols come first, as sh_info of .symtab requires, and both parts keep id order, so a STT_FILE symbol is
+    // followed by the local symbols of its file. symbols are split into chunks of consecutive ids: the chunks are
+    // counted in parallel and the positions of each chunk are the exclusive prefix sums of the counts of the chunks
+    // before it.
+    // `shndxs_` is st_shndx of each symbol in the output, indexed by `SymbolId`, or `kDropSymbol`
+    void layout_output(u64 num_threads, std::vector<u32> shndxs_) {
+        assert(shndxs_.size() == get_symbol_num());
+        output_shndxs = std::move(shndxs_);
+        output_names.assign(get_symbol_num(), std::string_view());
+
+        output_chunks.assign((get_symbol_num() + kOutputChunkSize - 1) / kOutputChunkSize, OutputChunk{});
+        Parallel::parallel_for(num_threads, output_chunks.size(), [&](u64 c) {
+            OutputChunk &chunk = output_chunks[c];
+            u64 end = std::min((c + 1) * kOutputChunkSize, get_symbol_num());
+            for (SymbolId id = c * kOutputChunkSize; id < end; id++) {
+                if (output_shndxs[id] == kDropSymbol) {
+                    continue;
+                }
+                output_names[id] = names[id];
+                if (get_bind(id) == STB_LOCAL) {
+                    chunk.local_index++;
+                } else {
+                    chunk.global_index++;
+                }
+            }
+        });
+
+        u64 local_num = 0;
+        u64 global_num = 0;
+        for (OutputChunk &chunk : output_chunks) {
+            local_num += std::exchange(chunk.local_index, local_num);
+            global_num += std::exchange(chunk.global_index, global_num);
+        }
+        for (OutputChunk &chunk : output_chunks) {
+            chunk.global_index += local_num;
+        }
+        output_local_num = local_num;
+        output_symbol_num = local_num + global_num;
+
+        // names of dropped symbols are empty, which every string table has
+        output_strtab.emplace(output_names, num_threads);
+    }
+
+    // number of local symbols in the output .symtab, which is its sh_info. valid after `layout_output()`
+    u64 get_output_local_num() const { return output_local_num; }
+
+    // number of symbols in the output .symtab. valid after `layout_output()`
+    u64 get_output_symbol_num() const { return output_symbol_num; }
+
+    u64 get_output_symtab_size() const { return output_symbol_num * sizeof(Elf64_Sym); }
+
+    u64 get_output_strtab_size() const { return output_strtab->get_size(); }
+
+    // write the output .symtab and .strtab, placed by `layout_output()`, to `symtab` and `strtab`. every chunk is
+    // written by one thread straight to its place
+    void write_output(u64 num_threads, u8 *symtab, u8 *strtab) const {
+        Parallel::parallel_for(num_threads, output_chunks.size(), [&](u64 c) {
+            OutputChunk chunk = output_chunks[c];
+            u64 end = std::min((c + 1) * kOutputChunkSize, get_symbol_num());
+            for (SymbolId id = c * kOutputChunkSize; id < end; id++) {
+                if (output_shndxs[id] == kDropSymbol) {
+                    continue;
+                }
+                u64 &index = (get_bind(id) == STB_LOCAL) ? chunk.local_index : chunk.global_index;
+                Elf64_Sym sym = get_elf_sym(id, output_strtab->get_offset(id), output_shndxs[id]);
+                std::memcpy(symtab + index * sizeof(Elf64_Sym), &sym, sizeof(Elf64_Sym));
+                index++;
+            }
+        });
+        output_strtab->write(num_threads, strtab);
+    }
+
+  private:
+    struct Slot {
+        // symbol whose name is the key of this slot. nullptr if the slot is empty.
+        // it points into the parsed input, which lives until the link ends
+        std::atomic<const Parse::SymTableEntry *> key{nullptr};
+        // rank of the current winner
+        std::atomic<u64> rank{kNoRank};
+        // id of the winner, set by `set_symbol()`
+        SymbolId id = kInvalidSymbolId;
+    };
+
+    // fields of the symbols, indexed by `SymbolId`. the fields of Elf64_Sym except st_name, which is assigned when
+    // the output .strtab is built
+    std::vector<std::string_view> names;
+    std::vector<u64> values;
+    std::vector<u64> sizes;
+    std::vector<u16> shndxs;
+    // st_info, the binding and type
+    std::vector<u8> infos;
+    std::vector<u8> others;
+    std::vector<u32> obj_indexes;
+
+    // symbols [c * kOutputChunkSize, (c + 1) * kOutputChunkSize) are the c-th chunk of the output
+    static constexpr u64 kOutputChunkSize = 4096;
+
+    // where the first local and the first global symbol of a chunk go in the output .symtab
+    struct OutputChunk {
+        u64 local_index;
+        u64 global_index;
+    };
+    std::vector<OutputChunk> output_chunks;
+    u64 output_local_num = 0;
+    u64 output_symbol_num = 0;
+    // st_shndx of the symbols in the output, indexed by `SymbolId`. `kDropSymbol` if not written
+    std::vector<u32> output_shndxs;
+    // names of the symbols, indexed by `SymbolId`. empty for dropped symbols
+    std::vector<std::string_view> output_names;
+    std::optional<StringTable> output_strtab;
+    // table from global symbol name to its winner
+    ConcurrentHashTable<Parse::SymTableEntry, Slot> slots;
+
+    void set_fields(SymbolId id, std::string_view name, const Elf64_Sym &sym, u32 obj_index) {
+        names[id] = name;
+        values[id] = sym.st_value;
+        sizes[id] = sym.st_size;
+        shndxs[id] = sym.st_shndx;
+        infos[id] = sym.st_info;
+        others[id] = sym.st_other;
+        obj_indexes[id] = obj_index;
+    }
+
+    static bool key_matches(const Parse::SymTableEntry *key, std::string_view name, u64 hash) {
+        return key->get_name_hash() == hash && key->get_name() == name;
+    }
+
+    Slot *find_slot(std::string_view name, u64 hash) const {
+        return slots.find(hash, [&](const Parse::SymTableEntry *key) { return key_matches(key, name, hash); });
+    }
+};
+
+} // namespace Myld
+
+#endif
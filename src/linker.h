@@ -1,7 +1,13 @@
 #include "builder.h"
 #include "context.h"
+#include "log.h"
 #include "myld.h"
+#include "parallel.h"
+#include "relocation.h"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
 #include <elf.h>
 #include <fstream>
 #include <map>
@@ -9,187 +15,278 @@
 
 namespace Myld {
 
-static void embed_raw_i32(std::vector<u8> &raw, u64 offset, i32 value) {
-    // little endian
-    raw[offset + 0] = (value >> 0) & 0xff;
-    raw[offset + 1] = (value >> 8) & 0xff;
-    raw[offset + 2] = (value >> 16) & 0xff;
-    raw[offset + 3] = (value >> 24) & 0xff;
-}
-
 class Linker {
   public:
-    Linker(std::vector<std::string> input_files, std::string output_file) : ctx(Context(input_files, output_file)) {}
+    Linker(Config config) : ctx(Context(config)) {}
 
     void link() {
         ctx.init();
+        {
+            ScopedTimer timer(ctx.time_trace, "link");
+            link_and_output();
+        }
+
+        if (auto filename = ctx.config.get_time_trace_file(); filename.has_value()) {
+            ctx.time_trace.write_json(filename.value());
+        }
+        if (ctx.config.get_print_stats()) {
+            ctx.print_stats();
+        }
+    }
+
+  private:
+    Context ctx;
+
+    void link_and_output() {
         ctx.parse_objects();
 
-        fmt::print("collecting symbols\n");
-        // push all symbols to linked symbol table
-        for (auto obj : ctx.objs) {
-            for (auto sym_entry : obj->get_sym_table().value().get_entries()) {
-                if (sym_entry->get_sym()->st_shndx == SHT_NULL) {
-                    // null symbol or undefined symbol
-                    continue;
-                }
+        MYLD_TRACE(Resolve, "collecting symbols\n");
+        {
+            ScopedTimer timer(ctx.time_trace, "resolve symbols");
+            ctx.resolve_symbols();
+        }
 
-                switch (sym_entry->get_type()) {
-                case STT_NOTYPE: {
-                    // アセンブリで書かれた関数はNO_TYPEになった
-                    auto sym = std::make_shared<LinkedSymTableEntry>(
-                        LinkedSymTableEntry::from(sym_entry, obj->get_filename()));
-                    // insert symbol
-                    if (!ctx.linked_sym_table.insert(sym)) {
-                        // duplicated symbol
-                        fmt::print("duplicated symbol\n");
-                        std::exit(1);
-                    }
-                } break;
-                case STT_SECTION: {
-                    if (sym_entry->get_name() == ".rodata") {
-                        // TODO: ここで指定されたセクションだけrodataをあつめればいいっぽい
-                    }
-                } break;
-                default: {
-                    auto sym = std::make_shared<LinkedSymTableEntry>(
-                        LinkedSymTableEntry::from(sym_entry, obj->get_filename()));
-                    // insert symbol
-                    if (!ctx.linked_sym_table.insert(sym)) {
-                        // duplicated symbol
-                        fmt::print("duplicated symbol\n");
-                        std::exit(1);
-                    }
-                } break;
-                }
+        if (MYLD_TRACE_ENABLED(Resolve)) {
+            fmt::print("linked sym table:\n");
+            for (SymbolId id = 0; id < ctx.linked_sym_table.get_symbol_num(); id++) {
+                fmt::print(" name: \"{}\"\n", ctx.linked_sym_table.get_name(id));
             }
         }
 
-        // debug
-        // dump symbols
-        fmt::print("linked sym table:\n");
-        for (auto &[symbol_name, symbol] : ctx.linked_sym_table.get_entries()) {
-            fmt::print(" name: \"{}\"\n", symbol_name);
+        {
+            ScopedTimer timer(ctx.time_trace, "gc sections");
+            ctx.mark_live_sections();
+        }
+        {
+            ScopedTimer timer(ctx.time_trace, "icf");
+            ctx.fold_identical_sections();
+        }
+        {
+            ScopedTimer timer(ctx.time_trace, "merge sections");
+            ctx.merge_sections();
+        }
+        {
+            ScopedTimer timer(ctx.time_trace, "order sections");
+            ctx.order_sections();
+        }
+
+        ctx.input_sections.resize(ctx.objs.size());
+        for (u64 i = 0; i < ctx.objs.size(); i++) {
+            ctx.input_sections[i].resize(ctx.objs[i]->get_section_num());
         }
 
-        // decide layout of `.text` here
-        // Generate .text section by just concatinating all .text sections (alignment = 1byte)
+        // decide layout of input sections here
+        // Every live SHF_ALLOC section goes to the output section given by `get_output_section_name()`
         {
-            std::vector<u8> text_raw({});
-            for (auto obj : ctx.objs) {
-                std::shared_ptr<Parse::Section> obj_text_section = obj->get_section_by_name(".text");
-                assert(obj_text_section != nullptr);
-                Raw obj_text_raw = obj_text_section->get_raw();
-                ctx.layout[obj_and_section(obj->get_filename(), ".text")] = text_raw.size();
-                text_raw.insert(text_raw.end(), obj_text_raw.begin(), obj_text_raw.end());
+            ScopedTimer timer(ctx.time_trace, "layout");
+            // input sections of each object, created in parallel
+            std::vector<std::vector<std::shared_ptr<InputSection>>> obj_members(ctx.objs.size());
+            Parallel::parallel_for(ctx.config.get_num_threads(), ctx.objs.size(), [&](u64 i) {
+                auto obj = ctx.objs[i];
+                for (u64 shndx = 0; shndx < obj->get_section_num(); shndx++) {
+                    const Elf64_Shdr *header = obj->get_section(shndx)->get_header();
+                    if ((header->sh_flags & SHF_ALLOC) && header->sh_type != SHT_GROUP && ctx.is_live(i, shndx) &&
+                        !ctx.is_folded(i, shndx) && ctx.get_mergeable_section(i, shndx) == nullptr) {
+                        obj_members[i].push_back(ctx.create_input_section(i, shndx));
+                    }
+                }
+            });
+
+            // output sections are created in the order they first appear, members are kept in input order
+            for (auto &members : obj_members) {
+                for (auto &member : members) {
+                    const Elf64_Shdr *header = member->get_section()->get_header();
+                    auto output_section = ctx.get_or_create_output_section(
+                        get_output_section_name(member->get_name()), header->sh_type,
+                        header->sh_flags & (SHF_ALLOC | SHF_WRITE | SHF_EXECINSTR | SHF_TLS), 1);
+                    output_section->append(member);
+                }
+            }
+
+            // sections ordered by `order_sections()` come first
+            if (!ctx.section_priorities.empty()) {
+                Parallel::parallel_for(ctx.config.get_num_threads(), ctx.output_sections.size(), [&](u64 i) {
+                    ctx.output_sections[i]->sort_members([&](const InputSection &member) {
+                        return ctx.get_section_priority(member.get_obj_index(), member.get_shndx());
+                    });
+                });
+            }
+
+            // each section lays out its members in parallel, so the sections go one by one
+            for (auto &output_section : ctx.output_sections) {
+                output_section->assign_offsets(ctx.config.get_num_threads());
+            }
+
+            // COMMON symbols get zero-initialized space at the end of .bss
+            const LinkedSymTable &symbols = ctx.linked_sym_table;
+            for (SymbolId id = 0; id < symbols.get_symbol_num(); id++) {
+                if (symbols.get_obj_index(id) != kNoObjIndex && symbols.get_shndx(id) == SHN_COMMON) {
+                    auto bss_section =
+                        ctx.get_or_create_output_section(".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE, 1);
+                    u64 offset = bss_section->allocate(symbols.get_size(id), std::max<u64>(symbols.get_value(id), 1));
+                    ctx.common_symbols.push_back(std::make_pair(id, offset));
+                }
+            }
+
+            // a folded section is an alias of the section it was folded into
+            for (auto &[folded, kept] : ctx.folded_sections) {
+                ctx.input_sections[folded.first][folded.second] = ctx.input_sections[kept.first][kept.second];
             }
-            ctx.section_raws[".text"] = text_raw;
         }
 
-        // decide layout of `.rodata` here
-        // Generate .text section by just concatinating all .rodata sections (alignment = 1byte)
-        // TODO: STT_SECTIONかつ名前が.rodataであるシンボルが含まれているセクションのrodataだけ集めればいいっぽい
+        // create `.got` here
+        // Every symbol referenced by a GOT-relative relocation gets one 8-byte entry holding its address.
+        // Symbols without a `SymbolId` (section symbols and undefined weak symbols) get one per object
         {
-            std::vector<u8> rodata_raw({});
-            for (auto obj : ctx.objs) {
-                std::shared_ptr<Parse::Section> obj_rodata_section = obj->get_section_by_name(".rodata");
-                if (obj_rodata_section != nullptr) {
-                    Raw obj_rodata_raw = obj_rodata_section->get_raw();
-                    ctx.layout[obj_and_section(obj->get_filename(), ".rodata")] = rodata_raw.size();
-                    rodata_raw.insert(rodata_raw.end(), obj_rodata_raw.begin(), obj_rodata_raw.end());
+            ScopedTimer timer(ctx.time_trace, "create .got");
+            u64 symbol_num = ctx.linked_sym_table.get_symbol_num();
+            std::unique_ptr<std::atomic<bool>[]> needs_got_entry = std::make_unique<std::atomic<bool>[]>(symbol_num);
+            std::vector<std::vector<u64>> unnamed_got_symbols(ctx.objs.size());
+            Parallel::parallel_for(ctx.config.get_num_threads(), ctx.objs.size(), [&](u64 i) {
+                auto obj = ctx.objs[i];
+                for (u64 shndx = 0; shndx < obj->get_section_num(); shndx++) {
+                    // relocations of discarded sections are never applied, nor read
+                    auto rela = obj->get_rela(shndx);
+                    if (rela == nullptr || !ctx.is_live(i, shndx)) {
+                        continue;
+                    }
+                    for (auto &rela_entry : rela->get_entries()) {
+                        if (!needs_got(rela_entry.get_type())) {
+                            continue;
+                        }
+                        SymbolId id = obj->get_symbol_id(rela_entry.get_sym());
+                        if (id != kInvalidSymbolId) {
+                            needs_got_entry[id].store(true, std::memory_order_relaxed);
+                            continue;
+                        }
+                        // an undefined strong symbol is reported when the relocation is applied
+                        const Parse::SymTableEntry &sym = obj->get_sym_table()->get_entries()[rela_entry.get_sym()];
+                        if (sym.get_type() == STT_SECTION || sym.get_bind() == STB_WEAK) {
+                            unnamed_got_symbols[i].push_back(rela_entry.get_sym());
+                        }
+                    }
+                }
+                std::sort(unnamed_got_symbols[i].begin(), unnamed_got_symbols[i].end());
+                unnamed_got_symbols[i].erase(std::unique(unnamed_got_symbols[i].begin(), unnamed_got_symbols[i].end()),
+                                             unnamed_got_symbols[i].end());
+            });
+
+            // entries are numbered in symbol id order, which is deterministic
+            u32 got_entry_num = 0;
+            ctx.got_entries = std::vector<u32>(symbol_num, Context::kNoGotEntry);
+            for (SymbolId id = 0; id < symbol_num; id++) {
+                if (needs_got_entry[id]) {
+                    ctx.got_entries[id] = got_entry_num++;
+                }
+            }
+            // followed by the symbols without an id, in input order
+            for (u64 i = 0; i < ctx.objs.size(); i++) {
+                for (u64 sym_index : unnamed_got_symbols[i]) {
+                    ctx.unnamed_got_entries[std::make_pair(i, sym_index)] = got_entry_num++;
                 }
             }
-            ctx.section_raws[".rodata"] = rodata_raw;
+            if (got_entry_num > 0) {
+                ctx.got_section =
+                    ctx.get_or_create_output_section(".got", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, sizeof(u64));
+                ctx.got_section->set_content(std::vector<u8>(got_entry_num * sizeof(u64), 0));
+            }
         }
 
-        // decide layout of `.data` here
+        // decide addresses of output sections here
+        // Output sections are sorted to code, read-only data, writable data and then zero-initialized data, and
+        // placed back to back from the load address of .text.
+        // Sections of a different PT_LOAD segment than the previous one (see `get_segment_flags()`) start at a new
+        // page, so that each segment can be mapped with its own permissions
         {
-            for (auto obj : ctx.objs) {
-                std::vector<std::shared_ptr<Parse::Section>> obj_dataname_sections =
-                    obj->get_section_starts_with(".data");
-
-                for (auto section : obj_dataname_sections) {
-                    std::string name = section->get_name();
-                    auto raw = section->get_raw().to_vec();
+            ScopedTimer timer(ctx.time_trace, "assign addresses");
+            auto rank = [](const std::shared_ptr<OutputSection> &output_section) {
+                if (output_section->get_type() == SHT_NOBITS) {
+                    return 3;
+                }
+                if (output_section->get_flags() & SHF_EXECINSTR) {
+                    return 0;
+                }
+                return (output_section->get_flags() & SHF_WRITE) ? 2 : 1;
+            };
+            std::stable_sort(ctx.output_sections.begin(), ctx.output_sections.end(),
+                             [&](auto &a, auto &b) { return rank(a) < rank(b); });
 
-                    ctx.layout[obj_and_section(obj->get_filename(), name)] = ctx.section_raws[name].size();
-                    ctx.section_raws[name].insert(ctx.section_raws[name].end(), raw.begin(), raw.end());
+            u64 addr = ctx.config.get_text_load_addr();
+            std::optional<u32> segment_flags = std::nullopt;
+            for (auto &output_section : ctx.output_sections) {
+                if (get_segment_flags(*output_section) != segment_flags) {
+                    segment_flags = get_segment_flags(*output_section);
+                    addr = align_to(addr, ctx.config.get_segment_align(segment_flags.value()));
                 }
+                addr = align_to(addr, output_section->get_align());
+                output_section->set_addr(addr);
+                addr += output_section->get_size();
             }
         }
 
         // resolve symbol address
-        for (auto &[symbol_name, symbol] : ctx.linked_sym_table.get_entries()) {
-            switch (symbol->get_type()) {
-            case STT_NOTYPE:
-                break;
-            case STT_FILE:
-                break;
-            case STT_FUNC: {
-                u64 resolved_addr = symbol->get_sym()->st_value + ctx.config.get_text_load_addr() +
-                                    ctx.layout[obj_and_section(symbol->get_obj_file_name(), ".text")];
-                symbol->get_sym()->st_value = resolved_addr;
-                if (symbol_name == "_start") {
-                    ctx._start_addr = resolved_addr;
+        {
+            ScopedTimer timer(ctx.time_trace, "resolve symbol addresses");
+            LinkedSymTable &symbols = ctx.linked_sym_table;
+            for (SymbolId id = 0; id < symbols.get_symbol_num(); id++) {
+                u32 obj_index = symbols.get_obj_index(id);
+                u16 shndx = symbols.get_shndx(id);
+                if (obj_index == kNoObjIndex || symbols.get_type(id) == STT_FILE || shndx == SHN_ABS ||
+                    shndx == SHN_COMMON) {
+                    continue;
+                }
+                if (ctx.get_mergeable_section(obj_index, shndx) != nullptr) {
+                    symbols.set_value(id, ctx.get_merged_addr(obj_index, shndx, symbols.get_value(id)));
+                    continue;
+                }
+                auto input_section = ctx.get_input_section(obj_index, shndx);
+                if (input_section == nullptr) {
+                    // symbols of sections removed by --gc-sections are not referenced from the output
+                    if (!ctx.is_live(obj_index, shndx)) {
+                        continue;
+                    }
+                    // nor are symbols of sections which are not laid out (e.g. non-SHF_ALLOC ones)
+                    MYLD_TRACE(Layout, "symbol \"{}\" in section {} of {} is not laid out\n", symbols.get_name(id),
+                               ctx.objs[obj_index]->get_section(shndx)->get_name(),
+                               ctx.objs[obj_index]->get_filename());
+                    continue;
+                }
+                symbols.set_value(id, symbols.get_value(id) + input_section->get_addr());
+            }
+
+            for (auto &[id, offset] : ctx.common_symbols) {
+                symbols.set_value(id, ctx.get_output_section(".bss")->get_addr() + offset);
+            }
+
+            // fill `.got` with the resolved addresses
+            for (SymbolId id = 0; id < ctx.got_entries.size(); id++) {
+                if (ctx.got_entries[id] != Context::kNoGotEntry) {
+                    u64 symbol_addr = symbols.get_value(id);
+                    std::memcpy(&ctx.got_section->get_mutable_content()[ctx.got_entries[id] * sizeof(u64)],
+                                &symbol_addr, sizeof(u64));
+                }
+            }
+            // an undefined weak symbol resolves to 0
+            for (auto &[key, got_entry] : ctx.unnamed_got_entries) {
+                if (auto symbol_addr = get_symbol_addr(ctx, key.first, key.second, 0); symbol_addr.has_value()) {
+                    std::memcpy(&ctx.got_section->get_mutable_content()[got_entry * sizeof(u64)], &symbol_addr.value(),
+                                sizeof(u64));
                 }
-            } break;
-            default: {
-                fmt::print("Not implemented: symbol type = 0x{:x}\n", symbol->get_type());
-                // exit(1);
-            } break;
             }
         }
 
+        if (SymbolId start = ctx.linked_sym_table.find("_start"); start != kInvalidSymbolId) {
+            ctx._start_addr = ctx.linked_sym_table.get_value(start);
+        }
         if (!ctx._start_addr.has_value()) {
             fmt::print("symbol `_start` not found. Could not create executable\n");
             std::exit(1);
         }
 
-        // resolve rela
-        fmt::print("resolving address\n");
-        for (auto obj : ctx.objs) {
-            auto rela_text = obj->get_rela_by_name(".text");
-            if (rela_text != nullptr) {
-                for (auto rela_entry : rela_text->get_entries()) {
-                    std::string rela_name = rela_entry->get_name();
-                    u32 rela_type = rela_entry->get_type();
-                    u64 rela_offset = rela_entry->get_rela()->r_offset;
-
-                    fmt::print("resolving rela: \"{}\"\n", rela_name);
-                    fmt::print("  rela type = 0x{:x}", rela_type);
-                    switch (rela_type) {
-                    case R_X86_64_PLT32: {
-                        fmt::print("(R_X86_64_PLT32)\n");
-                        // ELF spec (L + A - P)
-                        // ref:
-                        // https://stackoverflow.com/questions/64424692/how-does-the-address-of-r-x86-64-plt32-computed
-                        // (sym->st_value) + (Addend) - (0x80000 + rela->r_offset)
-                        std::shared_ptr<LinkedSymTableEntry> symbol =
-                            ctx.linked_sym_table.get_symbol_by_name(rela_name);
-                        assert(symbol != nullptr);
-                        i32 resolved_rel32 = symbol->get_sym()->st_value + rela_entry->get_rela()->r_addend -
-                                             (ctx.config.get_text_load_addr() + rela_entry->get_rela()->r_offset);
-
-                        fmt::print("  resolved rel32= {}\n", resolved_rel32);
-                        // FIXME:
-                        embed_raw_i32(ctx.section_raws[".text"],
-                                      rela_offset + ctx.layout[obj_and_section(obj->get_filename(), ".text")],
-                                      resolved_rel32);
-                    } break;
-                    default: {
-                        fmt::print("  Not implemented: rela type = 0x{:x}\n", rela_type);
-                        // exit(1);
-                    } break;
-                    }
-                }
-            }
-        }
+        // relocations are applied by the builder, directly in the output file
         // TODO: fix
         ctx.build_and_output();
     }
-
-  private:
-    Context ctx;
 };
 
 } // namespace Myld
\ No newline at end of file
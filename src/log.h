@@ -0,0 +1,87 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include "myld.h"
+#include <algorithm>
+#include <fmt/core.h>
+#include <fmt/format.h>
+#include <optional>
+#include <string_view>
+
+// messages above this level are compiled out, including the formatting of their arguments.
+// 0: diagnostics only, 1: also -v, 2: also --trace. set with `cmake -DMYLD_LOG_LEVEL=N`
+#ifndef MYLD_LOG_LEVEL
+#define MYLD_LOG_LEVEL 2
+#endif
+
+namespace Myld {
+namespace Log {
+
+// parts of the link which can be traced separately, e.g. `--trace=parse,reloc`
+enum Category : u32 {
+    Parse = 1 << 0,
+    Resolve = 1 << 1,
+    Layout = 1 << 2,
+    Reloc = 1 << 3,
+    Output = 1 << 4,
+};
+
+// set from the command line before the link starts, read-only afterwards
+inline bool verbose = false;
+inline u32 traced_categories = 0;
+
+inline bool is_traced(Category category) { return (traced_categories & category) != 0; }
+
+// parse a comma separated list of category names ("all" for every category).
+// returns std::nullopt if a name is unknown
+inline std::optional<u32> parse_categories(std::string_view list) {
+    u32 categories = 0;
+    while (!list.empty()) {
+        std::string_view name = list.substr(0, list.find(','));
+        list.remove_prefix(std::min(list.size(), name.size() + 1));
+        if (name == "parse") {
+            categories |= Parse;
+        } else if (name == "resolve") {
+            categories |= Resolve;
+        } else if (name == "layout") {
+            categories |= Layout;
+        } else if (name == "reloc") {
+            categories |= Reloc;
+        } else if (name == "output") {
+            categories |= Output;
+        } else if (name == "all") {
+            categories |= Parse | Resolve | Layout | Reloc | Output;
+        } else {
+            return std::nullopt;
+        }
+    }
+    return categories;
+}
+
+} // namespace Log
+} // namespace Myld
+
+// true if trace points of `category` print. a constant false when they are compiled out
+#define MYLD_TRACE_ENABLED(category) (MYLD_LOG_LEVEL >= 2 && Myld::Log::is_traced(Myld::Log::category))
+
+// progress messages printed with -v
+#define MYLD_INFO(...)                                                                                                 \
+    do {                                                                                                               \
+        if constexpr (MYLD_LOG_LEVEL >= 1) {                                                                           \
+            if (Myld::Log::verbose) {                                                                                  \
+                fmt::print(__VA_ARGS__);                                                                               \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while (0)
+
+// details printed with --trace=<category>. e.g. `MYLD_TRACE(Parse, "parsing sections[{}]\n", i);`
+#define MYLD_TRACE(category, ...)                                                                                      \
+    do {                                                                                                               \
+        if constexpr (MYLD_LOG_LEVEL >= 2) {                                                                           \
+            if (Myld::Log::is_traced(Myld::Log::category)) {                                                           \
+                fmt::print(__VA_ARGS__);                                                                               \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while (0)
+
+#endif
@@ -1,8 +1,12 @@
 #include "config.h"
 #include "linker.h"
+#include "log.h"
+#include "parallel.h"
 #include "reader.h"
 #include <fmt/core.h>
+#include <fmt/format.h>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -11,6 +15,17 @@ const char *kOutputFileName = "myld-a.out";
 int main(int argc, char *argv[]) {
     std::string output_filename = kOutputFileName;
     std::vector<std::string> input_filenames({});
+    std::optional<u64> num_threads = std::nullopt;
+    bool gc_sections = false;
+    Myld::IcfMode icf = Myld::IcfMode::None;
+    bool hugepage_text = false;
+    std::optional<std::string> symbol_ordering_file = std::nullopt;
+    std::optional<std::string> call_graph_ordering_file = std::nullopt;
+    bool call_graph_profile_sort = false;
+    std::optional<std::string> time_trace_file = std::nullopt;
+    bool time_trace = false;
+    bool print_stats = false;
+    std::vector<std::string> undefined_symbols({});
 
     int arg_index = 1;
     while (true) {
@@ -29,6 +44,144 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
+        if (std::string(argv[arg_index]).starts_with("--threads=")) {
+            std::string value = std::string(argv[arg_index]).substr(std::string("--threads=").size());
+            char *end = nullptr;
+            u64 n = std::strtoull(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0' || n == 0 || n > Myld::Parallel::kMaxThreads) {
+                fmt::print("invalid thread count: {} (must be 1 to {})\n", value, Myld::Parallel::kMaxThreads);
+                std::exit(1);
+            }
+            num_threads = n;
+            arg_index += 1;
+            continue;
+        }
+
+        if (std::string(argv[arg_index]) == "--gc-sections" || std::string(argv[arg_index]) == "--no-gc-sections") {
+            gc_sections = std::string(argv[arg_index]) == "--gc-sections";
+            arg_index += 1;
+            continue;
+        }
+
+        if (std::string(argv[arg_index]).starts_with("--icf=")) {
+            std::string value = std::string(argv[arg_index]).substr(std::string("--icf=").size());
+            if (value == "none") {
+                icf = Myld::IcfMode::None;
+            } else if (value == "safe") {
+                icf = Myld::IcfMode::Safe;
+            } else if (value == "all") {
+                icf = Myld::IcfMode::All;
+            } else {
+                fmt::print("unknown --icf mode: {}\n", value);
+                std::exit(1);
+            }
+            arg_index += 1;
+            continue;
+        }
+
+        if (std::string(argv[arg_index]) == "--hugepage-text" || std::string(argv[arg_index]) == "--no-hugepage-text") {
+            hugepage_text = std::string(argv[arg_index]) == "--hugepage-text";
+            arg_index += 1;
+            continue;
+        }
+
+        if (std::string(argv[arg_index]) == "--symbol-ordering-file" ||
+            std::string(argv[arg_index]) == "--call-graph-ordering-file") {
+            if (arg_index + 1 >= argc) {
+                fmt::print("{} needs a filename\n", argv[arg_index]);
+                std::exit(1);
+            }
+            if (std::string(argv[arg_index]) == "--symbol-ordering-file") {
+                symbol_ordering_file = argv[arg_index + 1];
+            } else {
+                call_graph_ordering_file = argv[arg_index + 1];
+            }
+            arg_index += 2;
+            continue;
+        }
+
+        if (std::string(argv[arg_index]).starts_with("--symbol-ordering-file=")) {
+            symbol_ordering_file = std::string(argv[arg_index]).substr(std::string("--symbol-ordering-file=").size());
+            arg_index += 1;
+            continue;
+        }
+
+        if (std::string(argv[arg_index]).starts_with("--call-graph-ordering-file=")) {
+            call_graph_ordering_file =
+                std::string(argv[arg_index]).substr(std::string("--call-graph-ordering-file=").size());
+            arg_index += 1;
+            continue;
+        }
+
+        if (std::string(argv[arg_index]) == "--call-graph-profile-sort" ||
+            std::string(argv[arg_index]) == "--no-call-graph-profile-sort") {
+            call_graph_profile_sort = std::string(argv[arg_index]) == "--call-graph-profile-sort";
+            arg_index += 1;
+            continue;
+        }
+
+        if (std::string(argv[arg_index]) == "--time-trace") {
+            time_trace = true;
+            arg_index += 1;
+            continue;
+        }
+
+        if (std::string(argv[arg_index]).starts_with("--time-trace-file=")) {
+            time_trace_file = std::string(argv[arg_index]).substr(std::string("--time-trace-file=").size());
+            arg_index += 1;
+            continue;
+        }
+
+        if (std::string(argv[arg_index]) == "-v" || std::string(argv[arg_index]) == "--verbose") {
+            Myld::Log::verbose = true;
+            arg_index += 1;
+            continue;
+        }
+
+        if (std::string(argv[arg_index]).starts_with("--trace=")) {
+            std::string value = std::string(argv[arg_index]).substr(std::string("--trace=").size());
+            std::optional<u32> categories = Myld::Log::parse_categories(value);
+            if (!categories.has_value()) {
+                fmt::print("unknown --trace category: {}\n", value);
+                std::exit(1);
+            }
+            if (MYLD_LOG_LEVEL < 2) {
+                fmt::print("warning: --trace is ignored. myld was built with MYLD_LOG_LEVEL={}\n", MYLD_LOG_LEVEL);
+            }
+            Myld::Log::traced_categories |= categories.value();
+            arg_index += 1;
+            continue;
+        }
+
+        if (std::string(argv[arg_index]) == "--stats") {
+            print_stats = true;
+            arg_index += 1;
+            continue;
+        }
+
+        if (std::string(argv[arg_index]) == "-u" || std::string(argv[arg_index]) == "--undefined") {
+            if (arg_index + 1 >= argc) {
+                fmt::print("{} needs a symbol name\n", argv[arg_index]);
+                std::exit(1);
+            }
+            undefined_symbols.push_back(argv[arg_index + 1]);
+            arg_index += 2;
+            continue;
+        }
+
+        if (std::string(argv[arg_index]).starts_with("--undefined=")) {
+            undefined_symbols.push_back(std::string(argv[arg_index]).substr(std::string("--undefined=").size()));
+            arg_index += 1;
+            continue;
+        }
+
+        // archives are searched repeatedly until no more members are pulled, so every archive is already in a group
+        if (std::string(argv[arg_index]) == "--start-group" || std::string(argv[arg_index]) == "--end-group" ||
+            std::string(argv[arg_index]) == "-(" || std::string(argv[arg_index]) == "-)") {
+            arg_index += 1;
+            continue;
+        }
+
         if (std::string(argv[arg_index]) == "-nostdlib") {
             fmt::print("warning: ignored -nostdlib\n");
             arg_index += 1;
@@ -42,23 +195,59 @@ int main(int argc, char *argv[]) {
     if (input_filenames.size() == 0) {
         fmt::print("myld (version {})\n", MYLD_VERSION);
         fmt::print("Usage: myld [options] <filename> ...\n");
+        fmt::print("  <filename> is an object file or a static archive (regular or thin)\n");
         fmt::print("Options:\n");
         fmt::print("  -o filename\tSet output filename\n");
+        fmt::print("  --threads=N\tUse N worker threads, at most 1024 (default: number of cores)\n");
+        fmt::print("  --gc-sections\tRemove sections unreachable from _start, --undefined symbols and kept sections\n");
+        fmt::print("  --icf=none|safe|all\n\t\tFold identical .text sections. safe keeps sections whose address is taken\n");
+        fmt::print("  --hugepage-text\tAlign the text segment to 2 MiB so that it can be backed by huge pages\n");
+        fmt::print("  --symbol-ordering-file=file\n\t\tPlace the sections of the symbols listed in file first\n");
+        fmt::print("  --call-graph-ordering-file=file\n\t\tSort sections by the call graph in file. each line is "
+                   "\"caller callee count\"\n");
+        fmt::print("  --call-graph-profile-sort\n\t\tSort sections by the .llvm.call-graph-profile sections of the "
+                   "inputs\n");
+        fmt::print("  --time-trace\tWrite a Chrome trace of the link to <output>.time-trace.json\n");
+        fmt::print("  --time-trace-file=file\n\t\tWrite the trace of --time-trace to file\n");
+        fmt::print("  -v, --verbose\tPrint what the linker does\n");
+        fmt::print("  --trace=category,...\n\t\tPrint details of parse, resolve, layout, reloc, output or all\n");
+        fmt::print("  --stats\tPrint input/output statistics and the time of each phase\n");
+        fmt::print("  -u symbol, --undefined=symbol\n\t\tTreat symbol as undefined (pulls archive members, gc root)\n");
+        fmt::print("  --start-group, --end-group\n\t\tAccepted for compatibility. archives are always searched repeatedly\n");
         std::exit(0);
     }
 
-    fmt::print("input file: ");
-    for (auto name : input_filenames) {
-        fmt::print("{}, ", name);
-    }
-    fmt::print("\n");
+    MYLD_INFO("input file: {}\n", fmt::join(input_filenames, ", "));
+    MYLD_INFO("output file: {}\n", output_filename);
 
-    fmt::print("output file: {}\n", output_filename);
+    Myld::Config config = Myld::Config(input_filenames, output_filename);
+    if (num_threads.has_value()) {
+        config.set_num_threads(num_threads.value());
+    }
+    // every phase runs on the same threads
+    Myld::Parallel::start_workers(config.get_num_threads());
+    config.set_gc_sections(gc_sections);
+    config.set_icf(icf);
+    config.set_hugepage_text(hugepage_text);
+    if (symbol_ordering_file.has_value()) {
+        config.set_symbol_ordering_file(symbol_ordering_file.value());
+    }
+    if (call_graph_ordering_file.has_value()) {
+        config.set_call_graph_ordering_file(call_graph_ordering_file.value());
+    }
+    config.set_call_graph_profile_sort(call_graph_profile_sort);
+    if (time_trace || time_trace_file.has_value()) {
+        config.set_time_trace_file(time_trace_file.value_or(output_filename + ".time-trace.json"));
+    }
+    config.set_print_stats(print_stats);
+    for (auto &name : undefined_symbols) {
+        config.add_undefined_symbol(name);
+    }
 
-    Myld::Linker linker = Myld::Linker(input_filenames, output_filename);
+    Myld::Linker linker = Myld::Linker(config);
     linker.link();
 
-    fmt::print("generated {}\n", output_filename);
+    MYLD_INFO("generated {}\n", output_filename);
 
     return 0;
 }
@@ -0,0 +1,107 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Myld {
+
+// read-only contents of an input file.
+// regular files are mapped with mmap(2) and never copied. other files (pipes, character devices, ...) cannot be
+// mapped, so they are read into a heap buffer instead
+class MappedFile {
+  public:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        if (is_mapped) {
+            munmap((void *)data, size);
+        }
+    }
+
+    static std::shared_ptr<MappedFile> open(std::string filename) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd == -1) {
+            fmt::print("Couldn't open {}: {}\n", filename, std::strerror(errno));
+            std::exit(1);
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+            fmt::print("Couldn't stat {}: {}\n", filename, std::strerror(errno));
+            std::exit(1);
+        }
+
+        std::shared_ptr<MappedFile> file;
+        // mmap(2) fails on empty files, so they also go through the buffered path
+        if (S_ISREG(st.st_mode) && st.st_size > 0) {
+            file = map(filename, fd, st.st_size);
+        } else {
+            file = read_all(filename, fd);
+        }
+        close(fd);
+        return file;
+    }
+
+    const uint8_t *get_data() const { return data; }
+
+    uint64_t get_size() const { return size; }
+
+  private:
+    MappedFile(const uint8_t *data, uint64_t size, bool is_mapped) : data(data), size(size), is_mapped(is_mapped) {}
+
+    static std::shared_ptr<MappedFile> map(std::string filename, int fd, uint64_t size) {
+        // the linker never writes to its inputs, so a private read-only mapping is enough
+        void *ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED) {
+            fmt::print("Couldn't map {}: {}\n", filename, std::strerror(errno));
+            std::exit(1);
+        }
+        // headers, symbols and section bodies are all touched soon, so ask the kernel to read ahead
+        madvise(ptr, size, MADV_WILLNEED);
+        return std::shared_ptr<MappedFile>(new MappedFile((const uint8_t *)ptr, size, true));
+    }
+
+    static std::shared_ptr<MappedFile> read_all(std::string filename, int fd) {
+        std::shared_ptr<MappedFile> file(new MappedFile(nullptr, 0, false));
+        uint8_t chunk[1 << 16];
+        while (true) {
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            if (n == -1) {
+                fmt::print("Couldn't read {}: {}\n", filename, std::strerror(errno));
+                std::exit(1);
+            }
+            if (n == 0) {
+                break;
+            }
+            file->buffer.insert(file->buffer.end(), chunk, chunk + n);
+        }
+        file->data = file->buffer.data();
+        file->size = file->buffer.size();
+        return file;
+    }
+
+    const uint8_t *data;
+    uint64_t size;
+    // true when `data` points to a mapping created by mmap(2)
+    bool is_mapped;
+    // backing storage of `data` for files which could not be mapped
+    std::vector<uint8_t> buffer;
+};
+
+} // namespace Myld
+
+#endif
@@ -0,0 +1,126 @@
+#include "context.h"
+#include "log.h"
+#include "merge.h"
+#include "parallel.h"
+#include <map>
+#include <tuple>
+
+namespace Myld {
+
+// whether the contents of a section can be merged. sections with relocations are kept as they are
+static bool is_mergeable(const Parse::Elf &obj, u64 shndx) {
+    const Elf64_Shdr *header = obj.get_section(shndx)->get_header();
+    return (header->sh_flags & SHF_MERGE) && (header->sh_flags & SHF_ALLOC) && !(header->sh_flags & SHF_WRITE) &&
+           header->sh_type == SHT_PROGBITS && header->sh_entsize > 0 &&
+           obj.get_rela(shndx) == nullptr;
+}
+
+void Context::merge_sections() {
+    u64 num_threads = config.get_num_threads();
+
+    // split mergeable sections into fragments
+    mergeable_sections.resize(objs.size());
+    Parallel::parallel_for(num_threads, objs.size(), [&](u64 i) {
+        const Parse::Elf &obj = *objs[i];
+        mergeable_sections[i].resize(obj.get_section_num());
+        for (u64 shndx = 0; shndx < obj.get_section_num(); shndx++) {
+            auto section = obj.get_section(shndx);
+            if (is_live(i, shndx) && is_mergeable(obj, shndx)) {
+                const Elf64_Shdr *header = section->get_header();
+                mergeable_sections[i][shndx] = std::make_shared<MergeableSection>(
+                    i, shndx, section->get_raw(), header->sh_entsize, header->sh_flags & SHF_STRINGS);
+            }
+        }
+    });
+
+    // group them by output section, kind of contents and alignment, in input order
+    std::map<std::tuple<std::string, u64, u64, u64>, u64> merged_index;
+    std::vector<std::vector<MergeableSection *>> members;
+    std::vector<MergeableSection *> all_members;
+    for (u64 i = 0; i < objs.size(); i++) {
+        for (auto &mergeable_section : mergeable_sections[i]) {
+            if (mergeable_section == nullptr) {
+                continue;
+            }
+            const Elf64_Shdr *header = objs[i]->get_section(mergeable_section->get_shndx())->get_header();
+            std::string name = get_output_section_name(objs[i]->get_section(mergeable_section->get_shndx())->get_name());
+            u64 flags = header->sh_flags & (SHF_ALLOC | SHF_EXECINSTR | SHF_MERGE | SHF_STRINGS);
+            u64 align = std::max<u64>(header->sh_addralign, 1);
+            auto key = std::make_tuple(name, flags, header->sh_entsize, align);
+            auto [iter, inserted] = merged_index.try_emplace(key, merged_sections.size());
+            if (inserted) {
+                merged_sections.push_back(std::make_shared<MergedSection>(name, flags, header->sh_entsize, align));
+                members.push_back({});
+            }
+            mergeable_section->set_parent(merged_sections[iter->second].get());
+            members[iter->second].push_back(mergeable_section.get());
+            all_members.push_back(mergeable_section.get());
+        }
+    }
+    if (merged_sections.empty()) {
+        return;
+    }
+
+    // deduplicate fragments of all sections at once
+    for (u64 m = 0; m < merged_sections.size(); m++) {
+        u64 fragment_num = 0;
+        for (auto member : members[m]) {
+            fragment_num += member->get_fragments().size();
+        }
+        merged_sections[m]->reserve(fragment_num);
+    }
+    Parallel::parallel_for(num_threads, all_members.size(), [&](u64 i) {
+        MergeableSection &member = *all_members[i];
+        for (u64 f = 0; f < member.get_fragments().size(); f++) {
+            member.set_merged(f, member.get_parent()->insert(&member.get_fragments()[f]));
+        }
+    });
+
+    // tail merging shares bytes between strings, so only plain 1-byte strings without alignment are tail merged
+    Parallel::parallel_for(num_threads, merged_sections.size(), [&](u64 m) {
+        const MergedSection &merged = *merged_sections[m];
+        merged_sections[m]->finalize(members[m],
+                                     merged.is_strings() && merged.get_entsize() == 1 && merged.get_align() == 1);
+    });
+
+    // merged contents go at the start of their output section, before the input sections placed there
+    std::vector<std::string> output_names;
+    for (auto &merged : merged_sections) {
+        if (std::find(output_names.begin(), output_names.end(), merged->get_output_section_name()) ==
+            output_names.end()) {
+            output_names.push_back(merged->get_output_section_name());
+        }
+    }
+    for (auto &name : output_names) {
+        std::vector<u8> content;
+        u64 align = 1;
+        u64 flags = 0;
+        for (auto &merged : merged_sections) {
+            if (merged->get_output_section_name() == name) {
+                align = std::max(align, merged->get_align());
+                flags |= merged->get_flags() & (SHF_ALLOC | SHF_EXECINSTR);
+            }
+        }
+        auto output_section = get_or_create_output_section(name, SHT_PROGBITS, flags, align);
+        for (auto &merged : merged_sections) {
+            if (merged->get_output_section_name() == name) {
+                content.resize(align_to(content.size(), merged->get_align()), 0);
+                merged->place(output_section.get(), content.size());
+                content.insert(content.end(), merged->get_content().begin(), merged->get_content().end());
+            }
+        }
+        output_section->set_content(std::move(content));
+    }
+
+    u64 fragment_num = 0;
+    u64 distinct_num = 0;
+    for (u64 m = 0; m < merged_sections.size(); m++) {
+        for (auto member : members[m]) {
+            fragment_num += member->get_fragments().size();
+        }
+        distinct_num += merged_sections[m]->get_fragment_num();
+    }
+    MYLD_INFO("merge: {} fragments merged into {}\n", fragment_num, distinct_num);
+}
+
+} // namespace Myld
@@ -0,0 +1,232 @@
+#ifndef MERGE_H
+#define MERGE_H
+
+#include "concurrent-hash-table.h"
+#include "myld.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <elf.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Myld {
+
+class OutputSection;
+class MergedSection;
+
+// a piece of a mergeable section: a string with its terminator, or one fixed-size entry
+struct SectionFragment {
+    std::string_view data;
+    u64 hash;
+};
+
+// distinct contents of fragments, i.e. one slot of the dedup table of a `MergedSection`
+struct MergedFragment {
+    // the first fragment inserted with these contents. nullptr if the slot is empty
+    std::atomic<const SectionFragment *> key{nullptr};
+    // offset in the merged section. decided by `MergedSection::finalize()`
+    u64 offset = kNotPlaced;
+
+    static constexpr u64 kNotPlaced = UINT64_MAX;
+};
+
+// an input section with SHF_MERGE, split into fragments whose contents are deduplicated across all inputs.
+// nothing of it is placed as is; every offset in it is translated with `get_output_offset()`
+class MergeableSection {
+  public:
+    MergeableSection(u32 obj_index, u32 shndx, Raw raw, u64 entsize, bool is_strings)
+        : obj_index(obj_index), shndx(shndx), parent(nullptr) {
+        std::string_view data((const char *)raw.begin(), raw.get_size());
+        u64 offset = 0;
+        while (offset < data.size()) {
+            u64 end;
+            if (is_strings) {
+                // a string ends with `entsize` zero bytes (e.g. 4 for UTF-32)
+                end = offset;
+                while (end + entsize <= data.size() && !is_zero(data.substr(end, entsize))) {
+                    end += entsize;
+                }
+                end = std::min(end + entsize, (u64)data.size());
+            } else {
+                end = std::min(offset + entsize, (u64)data.size());
+            }
+            std::string_view piece = data.substr(offset, end - offset);
+            offsets.push_back(offset);
+            fragments.push_back(SectionFragment{piece, hash_string(piece)});
+            offset = end;
+        }
+        merged = std::vector<MergedFragment *>(fragments.size(), nullptr);
+    }
+
+    u32 get_obj_index() const { return obj_index; }
+
+    u32 get_shndx() const { return shndx; }
+
+    const std::vector<SectionFragment> &get_fragments() const { return fragments; }
+
+    MergedSection *get_parent() const { return parent; }
+
+    void set_parent(MergedSection *parent_) { parent = parent_; }
+
+    MergedFragment *get_merged(u64 i) const { return merged[i]; }
+
+    void set_merged(u64 i, MergedFragment *fragment) { merged[i] = fragment; }
+
+    // offset in the output section of the byte at `offset` of this input section
+    u64 get_output_offset(u64 offset) const;
+
+  private:
+    u32 obj_index;
+    u32 shndx;
+    MergedSection *parent;
+    // start offset of each fragment in the input section, ascending
+    std::vector<u64> offsets;
+    std::vector<SectionFragment> fragments;
+    // the deduplicated slot of each fragment
+    std::vector<MergedFragment *> merged;
+
+    static bool is_zero(std::string_view s) {
+        return std::all_of(s.begin(), s.end(), [](char c) { return c == 0; });
+    }
+};
+
+// contents of all mergeable input sections of the same output section, type of contents and alignment.
+// fragments are deduplicated concurrently through a lock-free open-addressing table keyed by contents. the layout
+// only depends on input order, so the output is the same whatever the thread timing is
+class MergedSection {
+  public:
+    MergedSection(std::string output_section_name, u64 flags, u64 entsize, u64 align)
+        : output_section_name(output_section_name), flags(flags), entsize(entsize), align(align), offset(0),
+          output_section(nullptr) {}
+
+    std::string get_output_section_name() const { return output_section_name; }
+
+    u64 get_flags() const { return flags; }
+
+    u64 get_entsize() const { return entsize; }
+
+    u64 get_align() const { return align; }
+
+    bool is_strings() const { return flags & SHF_STRINGS; }
+
+    // allocate the table for up to `n` fragments. must be called before `insert()`
+    void reserve(u64 n) { slots.reserve(n); }
+
+    // find or add the slot of the contents of `fragment`. safe to call from multiple threads at once
+    MergedFragment *insert(const SectionFragment *fragment) {
+        return &slots.find_or_insert(fragment, fragment->hash, [&](const SectionFragment *key) {
+            return key->hash == fragment->hash && key->data == fragment->data;
+        });
+    }
+
+    // decide the offset of each distinct fragment and build the contents. `members` are the input sections of
+    // this merged section in input order; fragments are placed in the order they first appear.
+    // with `tail_merge`, a string which is a suffix of another one (e.g. "bar" of "foobar") shares its bytes
+    void finalize(const std::vector<MergeableSection *> &members, bool tail_merge) {
+        std::vector<MergedFragment *> distinct;
+        for (auto member : members) {
+            for (u64 i = 0; i < member->get_fragments().size(); i++) {
+                MergedFragment *fragment = member->get_merged(i);
+                if (fragment->offset == MergedFragment::kNotPlaced) {
+                    // mark as seen. the real offset is set below
+                    fragment->offset = 0;
+                    distinct.push_back(fragment);
+                }
+            }
+        }
+
+        // parent of each string when tail merging. sorted by reversed contents, a string is a suffix of another
+        // one iff it is a suffix of the one right after it
+        std::vector<MergedFragment *> tails_of(distinct.size(), nullptr);
+        if (tail_merge) {
+            std::vector<u64> sorted(distinct.size());
+            for (u64 i = 0; i < sorted.size(); i++) {
+                sorted[i] = i;
+            }
+            auto data = [&](u64 i) { return distinct[i]->key.load(std::memory_order_relaxed)->data; };
+            std::sort(sorted.begin(), sorted.end(), [&](u64 a, u64 b) {
+                std::string_view x = data(a);
+                std::string_view y = data(b);
+                return std::lexicographical_compare(x.rbegin(), x.rend(), y.rbegin(), y.rend());
+            });
+            for (u64 k = sorted.size(); k-- > 1;) {
+                std::string_view s = data(sorted[k - 1]);
+                std::string_view next = data(sorted[k]);
+                if (next.ends_with(s)) {
+                    MergedFragment *root = tails_of[sorted[k]] != nullptr ? tails_of[sorted[k]] : distinct[sorted[k]];
+                    tails_of[sorted[k - 1]] = root;
+                }
+            }
+        }
+
+        u64 size = 0;
+        for (u64 i = 0; i < distinct.size(); i++) {
+            if (tails_of[i] == nullptr) {
+                size = align_to(size, align);
+                distinct[i]->offset = size;
+                size += distinct[i]->key.load(std::memory_order_relaxed)->data.size();
+            }
+        }
+        for (u64 i = 0; i < distinct.size(); i++) {
+            if (tails_of[i] != nullptr) {
+                u64 root_size = tails_of[i]->key.load(std::memory_order_relaxed)->data.size();
+                u64 tail_size = distinct[i]->key.load(std::memory_order_relaxed)->data.size();
+                distinct[i]->offset = tails_of[i]->offset + root_size - tail_size;
+            }
+        }
+
+        content = std::vector<u8>(size, 0);
+        for (u64 i = 0; i < distinct.size(); i++) {
+            if (tails_of[i] == nullptr) {
+                std::string_view data = distinct[i]->key.load(std::memory_order_relaxed)->data;
+                std::memcpy(content.data() + distinct[i]->offset, data.data(), data.size());
+            }
+        }
+        fragment_num = distinct.size();
+    }
+
+    const std::vector<u8> &get_content() const { return content; }
+
+    // number of distinct fragments
+    u64 get_fragment_num() const { return fragment_num; }
+
+    OutputSection *get_output_section() const { return output_section; }
+
+    // offset from the start of the output section
+    u64 get_offset() const { return offset; }
+
+    void place(OutputSection *output_section_, u64 offset_) {
+        output_section = output_section_;
+        offset = offset_;
+    }
+
+  private:
+    std::string output_section_name;
+    u64 flags;
+    u64 entsize;
+    u64 align;
+    ConcurrentHashTable<SectionFragment, MergedFragment> slots;
+    std::vector<u8> content;
+    u64 fragment_num = 0;
+    u64 offset;
+    OutputSection *output_section;
+};
+
+inline u64 MergeableSection::get_output_offset(u64 offset) const {
+    assert(parent != nullptr);
+    if (offsets.empty()) {
+        return parent->get_offset();
+    }
+    // the fragment which contains `offset`. offsets past the end (e.g. `sym + size`) belong to the last one
+    u64 i = std::upper_bound(offsets.begin(), offsets.end(), offset) - offsets.begin();
+    i = i == 0 ? 0 : i - 1;
+    return parent->get_offset() + merged[i]->offset + (offset - offsets[i]);
+}
+
+} // namespace Myld
+
+#endif
@@ -1,9 +1,12 @@
 #ifndef MYLD_H
 #define MYLD_H
+#include "mapped-file.h"
 #include <cassert>
 #include <cstdint>
 #include <iterator>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -16,6 +19,28 @@ typedef int16_t i16;
 typedef int32_t i32;
 typedef int64_t i64;
 
+// index of a symbol in the linked symbol table
+typedef u32 SymbolId;
+// id of the null symbol, which is always the first symbol of the linked symbol table
+static constexpr SymbolId kNullSymbolId = 0;
+// id of a symbol which is not (or not yet) in the linked symbol table
+static constexpr SymbolId kInvalidSymbolId = UINT32_MAX;
+
+// 64-bit FNV-1a hash, used to key symbol names
+static inline u64 hash_string(std::string_view s) {
+    u64 hash = 0xcbf29ce484222325;
+    for (char c : s) {
+        hash = (hash ^ (u8)c) * 0x100000001b3;
+    }
+    return hash;
+}
+
+// round `value` up to a multiple of `align`, which must be a power of two
+static inline u64 align_to(u64 value, u64 align) {
+    assert(align != 0 && (align & (align - 1)) == 0);
+    return (value + align - 1) & ~(align - 1);
+}
+
 // (obj_filename, section_name) e.g. ("a.o", ".text")
 typedef std::pair<std::string, std::string> ObjAndSection;
 static ObjAndSection obj_and_section(std::string filename, std::string section) {
@@ -28,41 +53,37 @@ template <typename T> std::vector<u8> to_bytes(T data) {
     return v;
 }
 
-// reference to `std::vector<u8>`. this structure can be indexed
+// reference to a part of an input file. this structure can be indexed.
+// it is only a view into the file: section contents and symbols are never copied unless `to_vec()` is called.
+// it does not keep the file alive. the owner of the `MappedFile` (e.g. `Parse::Elf`) must outlive its views
 class Raw {
   public:
-    Raw(std::shared_ptr<const std::vector<u8>> raw) : raw(raw), offset(0), size(raw->size()) {}
+    Raw() : data(nullptr), size(0) {}
 
-    Raw get_sub(u64 offset_, u64 size_) {
-        assert(offset + offset + size_ < raw->size());
-        return Raw(raw, offset + offset_, size_);
+    Raw(const Myld::MappedFile &file) : data(file.get_data()), size(file.get_size()) {}
+
+    Raw get_sub(u64 offset_, u64 size_) const {
+        assert(offset_ + size_ <= size);
+        return Raw(data + offset_, size_);
     }
 
-    inline u8 operator[](std::size_t index) const { return (*raw)[index]; }
+    inline u8 operator[](std::size_t index) const { return data[index]; }
 
-    u8 *to_pointer() const { return (u8 *)&(*raw)[offset]; }
+    u8 *to_pointer() const { return (u8 *)data; }
 
     // copy data to a new vector and return it
-    std::vector<u8> to_vec() {
-        std::vector<u8> v1;
-        v1.reserve(size);
-        for (u64 u = 0; u < size; u++) {
-            v1.push_back((*raw)[offset + u]);
-        }
-        return v1;
-    }
+    std::vector<u8> to_vec() const { return std::vector<u8>(begin(), end()); }
 
     u64 get_size() const { return size; }
 
-    std::vector<u8>::const_iterator begin() const { return raw->begin() + offset; }
+    const u8 *begin() const { return data; }
 
-    std::vector<u8>::const_iterator end() const { return raw->begin() + offset + size; }
+    const u8 *end() const { return data + size; }
 
   private:
-    Raw(std::shared_ptr<const std::vector<u8>> raw, u64 offset, u64 size) : raw(raw), offset(offset), size(size) {}
+    Raw(const u8 *data, u64 size) : data(data), size(size) {}
 
-    std::shared_ptr<const std::vector<u8>> raw;
-    u64 offset;
+    const u8 *data;
     u64 size;
 };
 
@@ -0,0 +1,373 @@
+#include "context.h"
+#include "log.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
+
+namespace Myld {
+
+#ifndef SHT_LLVM_CALL_GRAPH_PROFILE
+#define SHT_LLVM_CALL_GRAPH_PROFILE 0x6fff4c09
+#endif
+
+// (object index, section index)
+typedef std::pair<u32, u32> SectionRef;
+
+// a weighted call from a section to another one
+typedef std::map<std::pair<SectionRef, SectionRef>, u64> CallGraph;
+
+static std::vector<std::string> read_lines(std::string filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        fmt::print("Couldn't open {}: {}\n", filename, std::strerror(errno));
+        std::exit(1);
+    }
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(file, line)) {
+        // comments start with #
+        line = line.substr(0, line.find('#'));
+        line.erase(0, line.find_first_not_of(" \t\r"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (!line.empty()) {
+            lines.push_back(line);
+        }
+    }
+    return lines;
+}
+
+// the section `shndx` of the `obj_index`-th object as it is laid out. a folded section is placed where the section
+// it was folded into is. nullopt if the section is not laid out on its own
+static std::optional<SectionRef> get_laid_out_section(const Context &ctx, u32 obj_index, u64 shndx) {
+    if (obj_index == kNoObjIndex || shndx == SHN_UNDEF || shndx >= SHN_LORESERVE ||
+        shndx >= ctx.objs[obj_index]->get_section_num()) {
+        return std::nullopt;
+    }
+    if (auto iter = ctx.folded_sections.find(SectionRef(obj_index, shndx)); iter != ctx.folded_sections.end()) {
+        return iter->second;
+    }
+    const Elf64_Shdr *header = ctx.objs[obj_index]->get_section(shndx)->get_header();
+    if (!(header->sh_flags & SHF_ALLOC) || !ctx.is_live(obj_index, shndx) ||
+        ctx.get_mergeable_section(obj_index, shndx) != nullptr) {
+        return std::nullopt;
+    }
+    return SectionRef(obj_index, shndx);
+}
+
+// section which the `sym_index`-th symbol of the `obj_index`-th object is defined in
+static std::optional<SectionRef> get_symbol_section(const Context &ctx, u32 obj_index, u64 sym_index) {
+    const Parse::Elf &obj = *ctx.objs[obj_index];
+    const Parse::SymTableEntry &sym = obj.get_sym_table()->get_entries()[sym_index];
+    if (sym.get_bind() == STB_LOCAL) {
+        return get_laid_out_section(ctx, obj_index, sym.get_sym()->st_shndx);
+    }
+    SymbolId id = obj.get_symbol_id(sym_index);
+    if (id == kInvalidSymbolId) {
+        return std::nullopt;
+    }
+    return get_laid_out_section(ctx, ctx.linked_sym_table.get_obj_index(id), ctx.linked_sym_table.get_shndx(id));
+}
+
+// sections defining each of `names`. a global definition is preferred to local ones, then the first local one in
+// input order is taken. nullopt for names which are not defined in a laid out section
+static std::vector<std::optional<SectionRef>> find_symbol_sections(const Context &ctx,
+                                                                   const std::vector<std::string> &names) {
+    std::vector<std::optional<SectionRef>> found(names.size(), std::nullopt);
+    std::unordered_map<std::string_view, u64> indexes;
+    for (u64 n = 0; n < names.size(); n++) {
+        indexes.try_emplace(names[n], n);
+        if (SymbolId id = ctx.linked_sym_table.find(names[n]); id != kInvalidSymbolId) {
+            found[n] =
+                get_laid_out_section(ctx, ctx.linked_sym_table.get_obj_index(id), ctx.linked_sym_table.get_shndx(id));
+        }
+    }
+
+    // local symbols, e.g. static functions
+    std::vector<std::vector<std::pair<u64, SectionRef>>> obj_found(ctx.objs.size());
+    Parallel::parallel_for(ctx.config.get_num_threads(), ctx.objs.size(), [&](u64 i) {
+        auto &sym_entries = ctx.objs[i]->get_sym_table()->get_entries();
+        for (u64 s = 1; s < sym_entries.size(); s++) {
+            const Parse::SymTableEntry &sym = sym_entries[s];
+            if (sym.get_bind() != STB_LOCAL || sym.get_type() == STT_SECTION || sym.get_type() == STT_FILE) {
+                continue;
+            }
+            auto iter = indexes.find(sym.get_name());
+            if (iter == indexes.end()) {
+                continue;
+            }
+            if (auto section = get_laid_out_section(ctx, i, sym.get_sym()->st_shndx); section.has_value()) {
+                obj_found[i].push_back(std::make_pair(iter->second, section.value()));
+            }
+        }
+    });
+    for (auto &pairs : obj_found) {
+        for (auto &[n, section] : pairs) {
+            if (!found[n].has_value()) {
+                found[n] = section;
+            }
+        }
+    }
+    return found;
+}
+
+// edges of the .llvm.call-graph-profile sections. a section is an array of weights, and the caller and callee of
+// the n-th edge are the symbols of the (2n)-th and (2n+1)-th relocations (R_X86_64_NONE). old objects have
+// 16-byte entries holding the symbol indexes instead
+static void add_call_graph_profile(const Context &ctx, CallGraph &graph) {
+    std::vector<std::vector<std::tuple<SectionRef, SectionRef, u64>>> obj_edges(ctx.objs.size());
+    Parallel::parallel_for(ctx.config.get_num_threads(), ctx.objs.size(), [&](u64 i) {
+        const Parse::Elf &obj = *ctx.objs[i];
+        for (u64 shndx = 0; shndx < obj.get_section_num(); shndx++) {
+            auto section = obj.get_section(shndx);
+            if (section->get_header()->sh_type != SHT_LLVM_CALL_GRAPH_PROFILE) {
+                continue;
+            }
+            Raw raw = section->get_raw();
+            std::vector<std::tuple<u64, u64, u64>> entries;
+            if (section->get_header()->sh_entsize == 16) {
+                for (u64 offset = 0; offset + 16 <= raw.get_size(); offset += 16) {
+                    u32 from, to;
+                    u64 weight;
+                    std::memcpy(&from, raw.begin() + offset, sizeof(u32));
+                    std::memcpy(&to, raw.begin() + offset + 4, sizeof(u32));
+                    std::memcpy(&weight, raw.begin() + offset + 8, sizeof(u64));
+                    entries.push_back(std::make_tuple(from, to, weight));
+                }
+            } else if (auto rela = obj.get_rela(shndx); rela != nullptr) {
+                auto rela_entries = rela->get_entries();
+                for (u64 n = 0; (n + 1) * sizeof(u64) <= raw.get_size() && 2 * n + 1 < rela_entries.size(); n++) {
+                    u64 weight;
+                    std::memcpy(&weight, raw.begin() + n * sizeof(u64), sizeof(u64));
+                    entries.push_back(
+                        std::make_tuple(rela_entries[2 * n].get_sym(), rela_entries[2 * n + 1].get_sym(), weight));
+                }
+            }
+
+            u64 symbol_num = obj.get_sym_table()->get_symbol_num();
+            for (auto &[from, to, weight] : entries) {
+                if (from >= symbol_num || to >= symbol_num) {
+                    continue;
+                }
+                auto from_section = get_symbol_section(ctx, i, from);
+                auto to_section = get_symbol_section(ctx, i, to);
+                if (from_section.has_value() && to_section.has_value()) {
+                    obj_edges[i].push_back(std::make_tuple(from_section.value(), to_section.value(), weight));
+                }
+            }
+        }
+    });
+    for (auto &edges : obj_edges) {
+        for (auto &[from, to, weight] : edges) {
+            graph[std::make_pair(from, to)] += weight;
+        }
+    }
+}
+
+// edges of a call graph ordering file
+static void add_call_graph_ordering_file(const Context &ctx, std::string filename, CallGraph &graph) {
+    std::vector<std::string> lines = read_lines(filename);
+    std::vector<std::string> names;
+    std::vector<u64> weights;
+    for (auto &line : lines) {
+        std::istringstream stream(line);
+        std::string from, to;
+        u64 weight;
+        if (!(stream >> from >> to >> weight)) {
+            fmt::print("{}: invalid line: {}\n", filename, line);
+            std::exit(1);
+        }
+        names.push_back(from);
+        names.push_back(to);
+        weights.push_back(weight);
+    }
+
+    std::vector<std::optional<SectionRef>> sections = find_symbol_sections(ctx, names);
+    for (u64 n = 0; n < weights.size(); n++) {
+        for (u64 k = 2 * n; k < 2 * n + 2; k++) {
+            if (!sections[k].has_value()) {
+                fmt::print("warning: {}: no such symbol: {}\n", filename, names[k]);
+            }
+        }
+        if (sections[2 * n].has_value() && sections[2 * n + 1].has_value()) {
+            graph[std::make_pair(sections[2 * n].value(), sections[2 * n + 1].value())] += weights[n];
+        }
+    }
+}
+
+// order sections by the C3 heuristic (Ottoni and Maher, "Optimizing Function Placement for Large-Scale Data-Center
+// Applications", CGO 2017), as lld does. every section starts as a cluster of its own. in decreasing order of
+// density (weight per byte), a cluster is appended to the cluster of its most frequent caller unless the result
+// gets too large or too sparse. the clusters are then placed in decreasing order of density, so that hot callees
+// follow their callers and hot code is packed densely
+static std::vector<SectionRef> sort_by_call_graph(const Context &ctx, const CallGraph &graph) {
+    // clusters larger than this do not fit in the i-TLB reach anyway
+    constexpr u64 kMaxClusterSize = 1024 * 1024;
+    // a merge may not make the density of the caller's cluster drop below 1/8
+    constexpr double kMaxDensityDegradation = 8.0;
+
+    struct Cluster {
+        u64 size;
+        u64 weight;
+        // weight of the section alone, i.e. the total weight of calls to it
+        u64 initial_weight;
+        // the caller with the heaviest edge to this section
+        i64 best_pred;
+        u64 best_pred_weight;
+        // members of a cluster form a circular list starting at the leader
+        u32 next;
+        u32 prev;
+
+        double get_density() const { return size == 0 ? 0 : (double)weight / size; }
+    };
+
+    std::map<SectionRef, u32> node_index;
+    std::vector<SectionRef> nodes;
+    auto get_node = [&](SectionRef section) {
+        auto [iter, inserted] = node_index.try_emplace(section, nodes.size());
+        if (inserted) {
+            nodes.push_back(section);
+        }
+        return iter->second;
+    };
+    for (auto &[edge, weight] : graph) {
+        get_node(edge.first);
+        get_node(edge.second);
+    }
+
+    std::vector<Cluster> clusters(nodes.size());
+    for (u32 i = 0; i < nodes.size(); i++) {
+        u64 size = ctx.objs[nodes[i].first]->get_section(nodes[i].second)->get_header()->sh_size;
+        clusters[i] = Cluster{size, 0, 0, -1, 0, i, i};
+    }
+    for (auto &[edge, weight] : graph) {
+        // calls between different output sections can not be brought closer
+        auto output_name = [&](SectionRef section) {
+            return get_output_section_name(ctx.objs[section.first]->get_section(section.second)->get_name());
+        };
+        if (output_name(edge.first) != output_name(edge.second)) {
+            continue;
+        }
+        u32 from = node_index[edge.first];
+        u32 to = node_index[edge.second];
+        clusters[to].weight += weight;
+        if (from == to) {
+            continue;
+        }
+        if (clusters[to].best_pred == -1 || clusters[to].best_pred_weight < weight) {
+            clusters[to].best_pred = from;
+            clusters[to].best_pred_weight = weight;
+        }
+    }
+    for (auto &cluster : clusters) {
+        cluster.initial_weight = cluster.weight;
+    }
+
+    std::vector<u32> sorted(clusters.size());
+    std::iota(sorted.begin(), sorted.end(), 0);
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [&](u32 a, u32 b) { return clusters[a].get_density() > clusters[b].get_density(); });
+
+    std::vector<u32> leaders(clusters.size());
+    std::iota(leaders.begin(), leaders.end(), 0);
+    auto get_leader = [&](u32 v) {
+        while (leaders[v] != v) {
+            leaders[v] = leaders[leaders[v]];
+            v = leaders[v];
+        }
+        return v;
+    };
+
+    for (u32 l : sorted) {
+        // `l` is still a leader here: a cluster is only merged into another one when it is visited
+        Cluster &cluster = clusters[l];
+        // an edge carrying less than a tenth of the calls is not worth following
+        if (cluster.best_pred == -1 || cluster.best_pred_weight * 10 <= cluster.initial_weight) {
+            continue;
+        }
+        u32 pred_l = get_leader(cluster.best_pred);
+        if (pred_l == l) {
+            continue;
+        }
+        Cluster &pred = clusters[pred_l];
+        if (cluster.size + pred.size > kMaxClusterSize) {
+            continue;
+        }
+        double new_density = (double)(pred.weight + cluster.weight) / (pred.size + cluster.size);
+        if (new_density < pred.get_density() / kMaxDensityDegradation) {
+            continue;
+        }
+
+        // append `cluster` to `pred`
+        leaders[l] = pred_l;
+        u32 pred_tail = pred.prev;
+        u32 tail = cluster.prev;
+        pred.prev = tail;
+        clusters[tail].next = pred_l;
+        cluster.prev = pred_tail;
+        clusters[pred_tail].next = l;
+        pred.size += cluster.size;
+        pred.weight += cluster.weight;
+        cluster.size = 0;
+        cluster.weight = 0;
+    }
+
+    sorted.clear();
+    for (u32 i = 0; i < clusters.size(); i++) {
+        if (get_leader(i) == i) {
+            sorted.push_back(i);
+        }
+    }
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [&](u32 a, u32 b) { return clusters[a].get_density() > clusters[b].get_density(); });
+
+    std::vector<SectionRef> order;
+    for (u32 leader : sorted) {
+        u32 i = leader;
+        do {
+            order.push_back(nodes[i]);
+            i = clusters[i].next;
+        } while (i != leader);
+    }
+    return order;
+}
+
+void Context::order_sections() {
+    // sections named by --symbol-ordering-file come first, in the order of the file
+    if (auto filename = config.get_symbol_ordering_file(); filename.has_value()) {
+        std::vector<std::string> names = read_lines(filename.value());
+        std::vector<std::optional<SectionRef>> sections = find_symbol_sections(*this, names);
+        for (u64 n = 0; n < names.size(); n++) {
+            if (!sections[n].has_value()) {
+                fmt::print("warning: {}: no such symbol: {}\n", filename.value(), names[n]);
+                continue;
+            }
+            section_priorities.try_emplace(sections[n].value(), section_priorities.size());
+        }
+        MYLD_INFO("order: {} sections ordered by {}\n", section_priorities.size(), filename.value());
+        return;
+    }
+
+    CallGraph graph;
+    if (auto filename = config.get_call_graph_ordering_file(); filename.has_value()) {
+        add_call_graph_ordering_file(*this, filename.value(), graph);
+    }
+    if (config.get_call_graph_profile_sort()) {
+        add_call_graph_profile(*this, graph);
+    }
+    if (graph.empty()) {
+        return;
+    }
+    for (auto &section : sort_by_call_graph(*this, graph)) {
+        section_priorities.try_emplace(section, section_priorities.size());
+    }
+    MYLD_INFO("order: {} sections ordered by {} call graph edges\n", section_priorities.size(), graph.size());
+}
+
+} // namespace Myld
@@ -0,0 +1,97 @@
+#ifndef OUTPUT_FILE_H
+#define OUTPUT_FILE_H
+
+#include "myld.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Myld {
+
+// output file whose whole contents are written through a pointer.
+// a regular file is sized once with ftruncate(2) and mapped, so bytes which are never written (e.g. padding) stay
+// sparse zeros. other files (pipes, /dev/stdout, ...) are assembled in a heap buffer and written out in `close()`
+class OutputFile {
+  public:
+    OutputFile(std::string filename, u64 size) : filename(filename), data(nullptr), size(size), fd(-1) {
+        // remove an old regular file first. rewriting it in place would break a running executable
+        struct stat st;
+        if (stat(filename.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            unlink(filename.c_str());
+        }
+
+        fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0777);
+        if (fd == -1) {
+            fmt::print("Couldn't open {}: {}\n", filename, std::strerror(errno));
+            std::exit(1);
+        }
+
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && size > 0 && ftruncate(fd, size) == 0) {
+            void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (ptr != MAP_FAILED) {
+                data = (u8 *)ptr;
+                return;
+            }
+        }
+
+        // buffered fallback
+        buffer = std::vector<u8>(size, 0);
+        data = buffer.data();
+    }
+
+    OutputFile(const OutputFile &) = delete;
+    OutputFile &operator=(const OutputFile &) = delete;
+
+    ~OutputFile() { close(); }
+
+    u8 *get_data() const { return data; }
+
+    u64 get_size() const { return size; }
+
+    // flush the contents and close the file
+    void close() {
+        if (fd == -1) {
+            return;
+        }
+
+        if (buffer.empty()) {
+            if (data != nullptr) {
+                munmap(data, size);
+            }
+        } else {
+            u64 written = 0;
+            while (written < size) {
+                ssize_t n = write(fd, buffer.data() + written, size - written);
+                if (n == -1 && errno == EINTR) {
+                    continue;
+                }
+                if (n == -1) {
+                    fmt::print("Couldn't write {}: {}\n", filename, std::strerror(errno));
+                    std::exit(1);
+                }
+                written += n;
+            }
+        }
+        ::close(fd);
+        fd = -1;
+        data = nullptr;
+    }
+
+  private:
+    std::string filename;
+    u8 *data;
+    u64 size;
+    int fd;
+    // backing storage of `data` when the file could not be mapped
+    std::vector<u8> buffer;
+};
+
+} // namespace Myld
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "myld.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace Myld {
+namespace Parallel {
+
+// largest number of threads accepted by `--threads`
+static constexpr u64 kMaxThreads = 1024;
+
+// number of worker threads used when `--threads` is not given
+static u64 default_num_threads() {
+    u64 n = std::thread::hardware_concurrency();
+    return std::clamp<u64>(n, 1, kMaxThreads);
+}
+
+// index of the worker running on the current thread: 0 for the thread calling `parallel_for()`, 1.. for the threads
+// of the pool. used to tell threads apart in --time-trace
+inline thread_local u32 current_worker_index = 0;
+
+// whether the current thread is running work items of a `parallel_for()`
+inline thread_local bool in_parallel_for = false;
+
+// threads which run the work of `parallel_for()`. they are started once and sleep between calls, so a phase does not
+// pay for creating and joining threads. only one job runs at a time
+class WorkerPool {
+  public:
+    // start `thread_num` threads. they are never joined and wait for work until the process exits
+    WorkerPool(u64 thread_num) : thread_num(thread_num) {
+        for (u64 t = 0; t < thread_num; t++) {
+            std::thread([this, t]() { run(t + 1); }).detach();
+        }
+    }
+
+    u64 get_thread_num() const { return thread_num; }
+
+    // run `job` on `worker_num` (at most `get_thread_num()`) threads of the pool. `wait()` for them to finish
+    void start(u64 worker_num, std::function<void()> job_) {
+        assert(worker_num <= thread_num);
+        std::lock_guard<std::mutex> lock(mutex);
+        job = std::move(job_);
+        job_worker_num = worker_num;
+        running_num = worker_num;
+        generation++;
+        wake.notify_all();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]() { return running_num == 0; });
+    }
+
+  private:
+    u64 thread_num;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::function<void()> job;
+    u64 job_worker_num = 0;
+    u64 running_num = 0;
+    // incremented by every `start()`. the next job cannot start before every thread of this one has run it, so a
+    // thread never misses a job it takes part in
+    u64 generation = 0;
+
+    void run(u32 worker_index) {
+        current_worker_index = worker_index;
+        u64 seen_generation = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&]() { return generation != seen_generation; });
+            seen_generation = generation;
+            if (worker_index > job_worker_num) {
+                continue;
+            }
+            lock.unlock();
+            job();
+            lock.lock();
+            if (--running_num == 0) {
+                done.notify_one();
+            }
+        }
+    }
+};
+
+// the pool of the process. it lives until the process exits, so that `std::exit()` from any thread is safe
+inline WorkerPool *worker_pool = nullptr;
+
+// start the pool for `num_threads` threads, the thread calling `parallel_for()` included. the first call decides the
+// size, later ones do nothing. must not be called concurrently
+inline void start_workers(u64 num_threads) {
+    if (worker_pool == nullptr) {
+        worker_pool = new WorkerPool(num_threads - 1);
+    }
+}
+
+// call `fn(i)` for every i in [0, n) on up to `num_threads` threads.
+// work items are handed out one by one, so uneven items (e.g. one huge object file) do not stall the others.
+// with `num_threads == 1` everything runs on the calling thread in index order, and so does a `parallel_for()` called
+// from a work item, since the pool is busy
+template <typename F> void parallel_for(u64 num_threads, u64 n, F fn) {
+    u64 worker_num = std::min(num_threads, n);
+    if (worker_num <= 1 || in_parallel_for) {
+        for (u64 i = 0; i < n; i++) {
+            fn(i);
+        }
+        return;
+    }
+    start_workers(num_threads);
+    worker_num = std::min(worker_num, worker_pool->get_thread_num() + 1);
+
+    std::atomic<u64> next_index(0);
+    auto worker = [&]() {
+        in_parallel_for = true;
+        while (true) {
+            u64 i = next_index.fetch_add(1, std::memory_order_relaxed);
+            if (i >= n) {
+                break;
+            }
+            fn(i);
+        }
+        in_parallel_for = false;
+    };
+
+    // the calling thread also works, so the pool runs one thread less
+    worker_pool->start(worker_num - 1, worker);
+    worker();
+    worker_pool->wait();
+}
+
+} // namespace Parallel
+} // namespace Myld
+
+#endif
@@ -1,15 +1,124 @@
 #include "parse-elf.h"
+#include "archive.h"
 #include "context.h"
 #include "reader.h"
+#include <set>
+#include <string_view>
+#include <unordered_set>
 
 namespace Myld {
 
+// add the global symbols of `obj` to the set of defined or undefined names. the names are views into the string
+// table of `obj`, which lives as long as the link
+static void collect_symbol_names(const Parse::Elf &obj, std::unordered_set<std::string_view> &defined,
+                                 std::unordered_set<std::string_view> &undefined) {
+    if (!obj.get_sym_table().has_value()) {
+        return;
+    }
+    for (auto &sym : obj.get_sym_table()->get_entries()) {
+        if (sym.get_bind() == STB_LOCAL) {
+            continue;
+        }
+        std::string_view name = sym.get_name();
+        if (sym.get_sym()->st_shndx != SHN_UNDEF) {
+            undefined.erase(name);
+            defined.insert(name);
+        } else if (sym.get_bind() != STB_WEAK && !defined.contains(name)) {
+            // undefined weak symbols do not pull archive members
+            undefined.insert(name);
+        }
+    }
+}
+
 void Context::parse_objects() {
-    for (auto file : this->config.get_input_filenames()) {
-        Myld::Elf::Reader reader(file);
-        // dump object file
-        reader.get_elf()->dump();
-        this->objs.push_back(reader.get_elf());
+    std::vector<std::string> input_filenames = this->config.get_input_filenames();
+
+    // map every input and tell archives from object files
+    std::vector<std::shared_ptr<const MappedFile>> files(input_filenames.size());
+    {
+        ScopedTimer timer(this->time_trace, "read inputs");
+        Parallel::parallel_for(this->config.get_num_threads(), input_filenames.size(),
+                               [&](u64 i) { files[i] = MappedFile::open(input_filenames[i]); });
+    }
+    for (auto &file : files) {
+        this->stats.input_bytes += file->get_size();
+    }
+    this->stats.input_file_num = files.size();
+
+    ScopedTimer timer(this->time_trace, "parse");
+
+    std::vector<std::string> obj_filenames;
+    std::vector<std::shared_ptr<const MappedFile>> obj_files;
+    std::vector<Parse::Archive> archives;
+    for (u64 i = 0; i < input_filenames.size(); i++) {
+        if (Parse::Archive::is_archive(*files[i])) {
+            archives.push_back(Parse::Archive(input_filenames[i], files[i]));
+        } else {
+            obj_filenames.push_back(input_filenames[i]);
+            obj_files.push_back(files[i]);
+        }
+    }
+
+    // each worker writes only its own slot, so `objs` stays in command-line order whatever the thread timing is
+    std::vector<std::shared_ptr<Myld::Parse::Elf>> parsed(obj_files.size());
+    Parallel::parallel_for(this->config.get_num_threads(), obj_files.size(), [&](u64 i) {
+        ScopedTimer timer(this->time_trace, "parse file", obj_filenames[i]);
+        Myld::Elf::Reader reader(obj_filenames[i], obj_files[i]);
+        parsed[i] = reader.get_elf();
+    });
+
+    // pull archive members which define a symbol that is still undefined, until nothing more is pulled.
+    // every archive is searched again in each round, so the order of archives does not matter (as if all of them
+    // were in one --start-group/--end-group). the names are only needed for this, so they are not collected at all
+    // without archives
+    std::unordered_set<std::string_view> defined;
+    std::unordered_set<std::string_view> undefined;
+    std::vector<std::string> undefined_symbols = this->config.get_undefined_symbols();
+    if (!archives.empty()) {
+        for (auto elf : parsed) {
+            collect_symbol_names(*elf, defined, undefined);
+        }
+        for (auto &name : undefined_symbols) {
+            if (!defined.contains(name)) {
+                undefined.insert(name);
+            }
+        }
+    }
+    std::vector<std::set<u64>> loaded_members(archives.size());
+    while (!undefined.empty()) {
+        // a symbol defined in several archives is taken from the first one
+        std::unordered_set<std::string_view> wanted = undefined;
+        std::vector<Parse::Archive::Member> members;
+        for (u64 i = 0; i < archives.size(); i++) {
+            for (auto &[name, offset] : archives[i].get_symbols()) {
+                if (wanted.contains(name) && !loaded_members[i].contains(offset)) {
+                    wanted.erase(name);
+                    loaded_members[i].insert(offset);
+                    members.push_back(archives[i].get_member(offset));
+                }
+            }
+        }
+        if (members.empty()) {
+            break;
+        }
+
+        std::vector<std::shared_ptr<Myld::Parse::Elf>> pulled(members.size());
+        Parallel::parallel_for(this->config.get_num_threads(), members.size(), [&](u64 i) {
+            ScopedTimer timer(this->time_trace, "parse file", members[i].name);
+            Myld::Elf::Reader reader(members[i].name, members[i].file, members[i].raw);
+            pulled[i] = reader.get_elf();
+        });
+        for (auto elf : pulled) {
+            collect_symbol_names(*elf, defined, undefined);
+            parsed.push_back(elf);
+        }
+    }
+
+    for (auto elf : parsed) {
+        if (MYLD_TRACE_ENABLED(Parse)) {
+            elf->dump();
+        }
+        this->objs.push_back(elf);
     }
 }
 
@@ -1,15 +1,21 @@
 #ifndef ELF_PARSED_H
 #define ELF_PARSED_H
 
+#include "arena.h"
+#include "log.h"
+#include "mapped-file.h"
 #include "myld.h"
+#include <atomic>
 #include <cassert>
+#include <cstring>
 #include <elf.h>
 #include <fmt/core.h>
 #include <fmt/format.h>
-#include <map>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 // TODO: 生ポインタを扱ってる箇所が十分なサイズのデータを指しているか確かめる必要がある
@@ -17,20 +23,36 @@
 namespace Myld {
 namespace Parse {
 
+// NUL-terminated string at `offset` of the string table `strtab`, without copying it.
+// it never reads past the end of the table: a string whose NUL is missing ends there
+static std::string_view get_string(Raw strtab, u64 offset) {
+    assert(offset <= strtab.get_size());
+    const char *begin = (const char *)strtab.begin() + offset;
+    return std::string_view(begin, strnlen(begin, strtab.get_size() - offset));
+}
+
+class Section;
+class SymTable;
+
+// a symbol of an input file. it is allocated in the arena of the file and only refers to the mapped input
 class SymTableEntry {
   public:
-    SymTableEntry(Raw raw_) : name(std::nullopt), raw(raw_) {
+    SymTableEntry(Raw raw_, const SymTable *table) : table(table), name_hash(0), raw(raw_) {
         // check size
         assert(raw_.get_size() == sizeof(Elf64_Sym));
     }
 
-    void set_name(std::string s) { name = s; }
+    // a view into .strtab (.shstrtab for section symbols), looked up on each call. it lives as long as the file
+    std::string_view get_name() const;
 
-    std::string get_name() const {
-        assert(name != std::nullopt);
-        return name.value();
+    // hash of the name of a global symbol, computed once when the file is parsed
+    u64 get_name_hash() const {
+        assert(get_bind() != STB_LOCAL);
+        return name_hash;
     }
 
+    void hash_name() { name_hash = hash_string(get_name()); }
+
     // TODO: change to const Elf64_Sym*?
     Elf64_Sym *get_sym() const { return (Elf64_Sym *)raw.to_pointer(); }
 
@@ -41,31 +63,42 @@ class SymTableEntry {
     u8 get_type() const { return ELF64_ST_TYPE(get_sym()->st_info); }
 
   private:
-    std::optional<std::string> name;
+    // the table this symbol is in, which knows where the names are
+    const SymTable *table;
+    u64 name_hash;
     Raw raw;
 };
 
 class SymTable {
   public:
-    SymTable(Elf64_Shdr *sheader, Raw raw) : sheader(sheader), entries({}) {
+    // `strtab` is the string table of the symbol names, `sections` are the sections of the file
+    SymTable(Elf64_Shdr *sheader, Raw raw, Raw strtab, std::span<const Section> sections, Arena &arena)
+        : sheader(sheader), strtab(strtab), sections(sections), entries({}) {
         assert(sheader->sh_entsize == sizeof(Elf64_Sym));
         symbol_num = sheader->sh_size / sheader->sh_entsize;
-        fmt::print("found .symtab section (symbol num = {})\n", symbol_num);
+        MYLD_TRACE(Parse, "found .symtab section (symbol num = {})\n", symbol_num);
 
-        for (int i = 0; i < symbol_num; i++) {
-            u32 start = i * sizeof(Elf64_Sym);
-            entries.push_back(std::make_shared<SymTableEntry>(SymTableEntry(raw.get_sub(start, sizeof(Elf64_Sym)))));
-        }
+        entries = arena.create_array<SymTableEntry>(symbol_num, [&](u64 i) {
+            return SymTableEntry(raw.get_sub(i * sizeof(Elf64_Sym), sizeof(Elf64_Sym)), this);
+        });
     }
 
+    SymTable(const SymTable &) = delete;
+    SymTable &operator=(const SymTable &) = delete;
+
+    // name of the symbol whose header is `sym`
+    std::string_view get_name(const Elf64_Sym *sym) const;
+
+    Raw get_strtab() const { return strtab; }
+
     u64 get_symbol_num() const { return symbol_num; }
     Elf64_Shdr *get_sheader() const { return sheader; }
-    std::vector<std::shared_ptr<SymTableEntry>> get_entries() const { return entries; }
+    const std::span<SymTableEntry> &get_entries() const { return entries; }
 
-    std::shared_ptr<SymTableEntry> get_symbol_by_name(std::string name) {
-        for (auto entry : entries) {
-            if (entry->get_name() == name) {
-                return entry;
+    SymTableEntry *get_symbol_by_name(std::string_view name) const {
+        for (auto &entry : entries) {
+            if (entry.get_name() == name) {
+                return &entry;
             }
         }
         return nullptr;
@@ -74,95 +107,113 @@ class SymTable {
   private:
     // section header of .symtab
     Elf64_Shdr *sheader;
+    Raw strtab;
+    std::span<const Section> sections;
     // number of symbols
     u64 symbol_num;
-    std::vector<std::shared_ptr<SymTableEntry>> entries;
+    // allocated in the arena of the file
+    std::span<SymTableEntry> entries;
 };
 
+// a relocation, read in place from the mapped relocation table
 class RelaTextEntry {
   public:
-    RelaTextEntry(Raw raw_) : name(std::nullopt), raw(raw_) {}
-
-    void set_name(std::string s) { name = s; }
-
-    std::string get_name() const {
-        assert(name != std::nullopt);
-        return name.value();
-    }
-
-    // TODO: change to const Elf64_Rela*?
-    Elf64_Rela *get_rela() const { return (Elf64_Rela *)raw.to_pointer(); }
+    const Elf64_Rela *get_rela() const { return &rela; }
 
-    u32 get_type() const { return ELF64_R_TYPE(get_rela()->r_info); }
+    u32 get_type() const { return ELF64_R_TYPE(rela.r_info); }
 
-    u32 get_sym() const { return ELF64_R_SYM(get_rela()->r_info); }
+    u32 get_sym() const { return ELF64_R_SYM(rela.r_info); }
 
   private:
-    std::optional<std::string> name;
-    Raw raw;
+    Elf64_Rela rela;
 };
+static_assert(sizeof(RelaTextEntry) == sizeof(Elf64_Rela));
 
+// a relocation table. only its header is read when the file is parsed: the entries are a view into the mapped file,
+// checked the first time a pass asks for them. tables of sections no pass looks at (debug info, sections discarded
+// by --gc-sections) are never read at all
 class Rela {
   public:
-    Rela(Elf64_Shdr *sheader, Raw raw) : sheader(sheader), entries({}) {
+    // `symbol_num` is the size of the symbol table the relocations refer to
+    Rela(Elf64_Shdr *sheader, Raw raw, u64 symbol_num, std::string_view filename)
+        : sheader(sheader), raw(raw), symbol_num(symbol_num), filename(filename), checked(false) {
         assert(sheader->sh_entsize == sizeof(Elf64_Rela));
-        reloc_num = sheader->sh_size / sheader->sh_entsize;
-        fmt::print("found .rela.text section (relocation num = {})\n", reloc_num);
-
-        for (int i = 0; i < reloc_num; i++) {
-            u32 start = i * sizeof(Elf64_Rela);
-            entries.push_back(std::make_shared<RelaTextEntry>(RelaTextEntry(raw.get_sub(start, sizeof(Elf64_Sym)))));
-        }
+        reloc_num = raw.get_size() / sizeof(Elf64_Rela);
     }
 
     Elf64_Shdr *get_sheader() const { return sheader; }
     u64 get_reloc_num() const { return reloc_num; }
-    std::vector<std::shared_ptr<RelaTextEntry>> get_entries() const { return entries; }
+
+    // safe to call from several threads: at worst the first callers check the table at the same time
+    std::span<const RelaTextEntry> get_entries() const {
+        std::span<const RelaTextEntry> entries((const RelaTextEntry *)raw.begin(), reloc_num);
+        if (!checked.load(std::memory_order_acquire)) {
+            // relocations must refer to a symbol of this file
+            for (auto &rela_entry : entries) {
+                if (rela_entry.get_sym() >= symbol_num) {
+                    fmt::print("{}: relocation refers to symbol {} which does not exist\n", filename,
+                               rela_entry.get_sym());
+                    std::exit(1);
+                }
+            }
+            checked.store(true, std::memory_order_release);
+        }
+        return entries;
+    }
 
   private:
-    // section header of .rela.text
+    // section header of .rela.*
     Elf64_Shdr *sheader;
+    Raw raw;
     // number of relocations
     u64 reloc_num;
-    std::vector<std::shared_ptr<RelaTextEntry>> entries;
+    u64 symbol_num;
+    // for diagnostics. a view of the filename of the elf
+    std::string_view filename;
+    mutable std::atomic<bool> checked;
 };
 
 // struct represents a section. this contains section header
 class Section {
   public:
-    Section(Elf64_Shdr *header, Raw raw) : name(std::nullopt), header(header), raw(raw) {
+    // `shstrtab` is the section name string table of the file, whose names are in bounds
+    Section(Elf64_Shdr *header, Raw raw, const Raw *shstrtab) : header(header), raw(raw), shstrtab(shstrtab) {
         assert((header->sh_addralign == 0 && header->sh_type == SHT_NULL) ||
                ((header->sh_offset % header->sh_addralign) == 0));
     }
 
-    void set_name(std::string s) { name = s; }
+    // a view into .shstrtab, looked up on each call
+    std::string_view get_name() const { return get_string(*shstrtab, header->sh_name); }
 
-    std::string get_name() const {
-        assert(name != std::nullopt);
-        return name.value();
-    }
     Raw get_raw() const { return raw; }
     Elf64_Shdr *get_header() const { return header; }
 
   private:
-    std::optional<std::string> name;
     // section header
     Elf64_Shdr *header;
     // content of the section
     Raw raw;
+    const Raw *shstrtab;
 };
 
 class Elf {
   public:
     // create from raw data
-    Elf(std::string filename, std::shared_ptr<const std::vector<u8>> raw_bytes)
-        : filename(filename), raw(Raw(raw_bytes)), sections({}), sym_table(std::nullopt), relas({}) {
-        fmt::print("parsing elf header\n");
+    // `raw` is a whole object file, or a member of an archive, in `file`.
+    // sections, symbols and relocations are allocated in the arena of this elf and point into `file`, so all of them
+    // are released together with the elf
+    Elf(std::string filename, std::shared_ptr<const MappedFile> file, Raw raw)
+        : filename(filename), file(file), raw(raw), shstrtab(), sections({}), sym_table(std::nullopt), relas({}) {
+        MYLD_TRACE(Parse, "parsing elf header of {}\n", filename);
         // get elf header
-        eheader = (Elf64_Ehdr *)&((*raw_bytes)[0]);
+        if (raw.get_size() < sizeof(Elf64_Ehdr) || std::memcmp(raw.begin(), ELFMAG, SELFMAG) != 0) {
+            fmt::print("{} is not an ELF file\n", filename);
+            std::exit(1);
+        }
+        eheader = (Elf64_Ehdr *)raw.to_pointer();
 
         // get program header
-        fmt::print("parsing program header\n");
+        MYLD_TRACE(Parse, "parsing program header\n");
         if (get_elf_type() == ET_EXEC) {
             for (int i = 0; i < get_program_header_num(); i++) {
                 pheader.push_back((Elf64_Phdr *)raw.get_sub(0, sizeof(Elf64_Phdr)).to_pointer());
@@ -171,89 +222,89 @@ class Elf {
 
         // get section header
         std::vector<Elf64_Shdr *> section_headers;
-        fmt::print("parsing section header\n");
-        for (int i = 0; i < get_section_num(); i++) {
+        MYLD_TRACE(Parse, "parsing section header\n");
+        for (u64 i = 0; i < get_section_num(); i++) {
             u64 sheader_elem_offset = eheader->e_shoff + eheader->e_shentsize * i;
-            section_headers.push_back((Elf64_Shdr *)raw.get_sub(sheader_elem_offset, sizeof(Elf64_Ehdr)).to_pointer());
+            section_headers.push_back((Elf64_Shdr *)raw.get_sub(sheader_elem_offset, sizeof(Elf64_Shdr)).to_pointer());
         }
 
-        // get raw data of section body
-        fmt::print("parsing elf body\n");
-        for (int i = 0; i < get_section_num(); i++) {
-            fmt::print("parsing sections[{}]\n", i);
-            Elf64_Shdr *section_header = section_headers[i];
-            Raw section_raw = raw.get_sub(section_header->sh_offset, section_header->sh_size);
-
-            std::shared_ptr<Section> section = std::make_shared<Section>(Section(section_header, section_raw));
-            sections.push_back(section);
+        // section names are views into .shstrtab. only their offsets are checked here
+        if (eheader->e_shstrndx >= section_headers.size()) {
+            fmt::print("{}: invalid e_shstrndx {}\n", filename, eheader->e_shstrndx);
+            std::exit(1);
         }
-
-        // get section name from .shstrtab
-        Raw shstrtab_raw = sections[eheader->e_shstrndx]->get_raw();
-        for (int i = 0; i < get_section_num(); i++) {
-            u64 name_index = section_headers[i]->sh_name;
-            // FIXME: とりあえず20
-            std::string name(shstrtab_raw.to_pointer() + name_index, shstrtab_raw.to_pointer() + name_index + 20);
-            sections[i]->set_name(name.c_str());
+        Elf64_Shdr *shstrtab_header = section_headers[eheader->e_shstrndx];
+        shstrtab = raw.get_sub(shstrtab_header->sh_offset, shstrtab_header->sh_size);
+        for (u64 i = 0; i < get_section_num(); i++) {
+            if (section_headers[i]->sh_name > shstrtab.get_size()) {
+                fmt::print("{}: name of section {} is out of .shstrtab\n", filename, i);
+                std::exit(1);
+            }
         }
 
-        // parse section data
-        for (auto section : sections) {
-            Elf64_Shdr *sheader = section->get_header();
-            // found symbol table
+        // get raw data of section body
+        MYLD_TRACE(Parse, "parsing elf body\n");
+        sections = arena.create_array<Section>(get_section_num(), [&](u64 i) {
+            MYLD_TRACE(Parse, "parsing sections[{}]\n", i);
+            Elf64_Shdr *section_header = section_headers[i];
+            // SHT_NOBITS sections (e.g. .bss) occupy no bytes in the file
+            u64 body_size = (section_header->sh_type == SHT_NOBITS) ? 0 : section_header->sh_size;
+            return Section(section_header, raw.get_sub(section_header->sh_offset, body_size), &shstrtab);
+        });
+
+        // index the symbol table
+        for (auto &section : sections) {
+            Elf64_Shdr *sheader = section.get_header();
             if (sheader->sh_type == SHT_SYMTAB) {
-                assert(section->get_name() == ".symtab");
-                sym_table = std::make_optional<SymTable>(SymTable(sheader, section->get_raw()));
-            } else if (sheader->sh_type == SHT_RELA) {
-                std::string section_name = section->get_name();
-                std::string referent_section_name(section_name.begin() + 5, section_name.end());
-                // .rela*name*があるのに*name*セクションがない
-                assert(get_section_by_name(referent_section_name) != nullptr);
-
-                relas[referent_section_name] = std::make_shared<Rela>(Rela(sheader, section->get_raw()));
+                assert(!sym_table.has_value() && section.get_name() == ".symtab");
+                // sh_link is the index of the string table of the symbol names
+                if (sheader->sh_link >= sections.size() ||
+                    sections[sheader->sh_link].get_header()->sh_type != SHT_STRTAB) {
+                    fmt::print("{}: .symtab has no string table\n", filename);
+                    std::exit(1);
+                }
+                sym_table.emplace(sheader, section.get_raw(), sections[sheader->sh_link].get_raw(), sections, arena);
             }
         }
 
         // make sure elf contains .symtab, .strtab, and .shstrtab
         assert(get_section_by_name(".symtab") != nullptr && sym_table.has_value());
+        symbol_ids = std::vector<SymbolId>(sym_table->get_symbol_num(), kInvalidSymbolId);
         assert(get_section_by_name(".strtab") != nullptr);
         assert(get_section_by_name(".shstrtab") != nullptr);
 
-        fmt::print("looking up symbol names\n");
-
-        // lookup name of each symbol table entry
-        auto strtab = get_section_by_name(".strtab");
-        auto symtab_entries = sym_table->get_entries();
-        for (int i = 0; i < sym_table->get_symbol_num(); i++) {
-            std::string symbol_name;
-            if (symtab_entries[i]->get_type() == STT_SECTION) {
-                u16 shndx = symtab_entries[i]->get_sym()->st_shndx;
-                symbol_name = sections[shndx]->get_name();
-            } else {
-                auto name_index = symtab_entries[i]->get_sym()->st_name;
-                // FIXME: とりあえず20
-                symbol_name = std::string(strtab->get_raw().to_pointer() + name_index,
-                                          strtab->get_raw().to_pointer() + name_index + 20)
-                                  .c_str();
+        // find relocation tables. their entries are not read until they are used
+        relas = arena.create_array<Rela *>(sections.size(), [](u64) { return nullptr; });
+        for (auto &section : sections) {
+            Elf64_Shdr *sheader = section.get_header();
+            if (sheader->sh_type == SHT_RELA) {
+                // sh_info is the index of the section the relocations apply to
+                assert(sheader->sh_info < sections.size());
+                MYLD_TRACE(Parse, "found relocation table of {} (relocation num = {})\n",
+                           sections[sheader->sh_info].get_name(), sheader->sh_size / sizeof(Elf64_Rela));
+                relas[sheader->sh_info] =
+                    arena.create<Rela>(sheader, section.get_raw(), sym_table->get_symbol_num(), this->filename);
             }
-            symtab_entries[i]->set_name(symbol_name);
         }
 
-        // lookup name of each rela entry
-        for (auto &[_, rela] : relas) {
-            auto symtab = get_section_by_name(".symtab");
-            auto rela_entries = rela->get_entries();
-            for (int i = 0; i < rela->get_reloc_num(); i++) {
-                // FIXME: これってほんとにsymbol table entryのインデックスを表してるの?
-                auto symbol_index = rela_entries[i]->get_sym();
-                // FIXME: とりあえず20
-                std::string symbol_name = symtab_entries[symbol_index]->get_name();
-                // std::string(&(symtab->get_raw()[name_index]), &(symtab->get_raw()[name_index + 20])).c_str();
-                rela_entries[i]->set_name(symbol_name);
+        // names are not read here, only checked to be in bounds. they are views looked up when needed, except the
+        // names of global symbols, which are hashed for symbol resolution
+        u64 strtab_size = sym_table->get_strtab().get_size();
+        for (auto &sym : sym_table->get_entries()) {
+            if (sym.get_type() == STT_SECTION ? sym.get_sym()->st_shndx >= sections.size()
+                                              : sym.get_sym()->st_name > strtab_size) {
+                fmt::print("{}: name of symbol {} is out of range\n", filename, &sym - sym_table->get_entries().data());
+                std::exit(1);
+            }
+            if (sym.get_bind() != STB_LOCAL) {
+                sym.hash_name();
             }
         }
     }
 
+    Elf(const Elf &) = delete;
+    Elf &operator=(const Elf &) = delete;
+
     std::string get_filename() const { return filename; }
 
     u8 get_elf_type() { return eheader->e_type; }
@@ -266,73 +317,99 @@ class Elf {
 
     Raw get_raw() { return raw; }
 
-    u64 get_section_num() { return eheader->e_shnum; }
+    u64 get_section_num() const { return eheader->e_shnum; }
 
     u64 get_program_header_num() { return eheader->e_phnum; }
 
-    std::shared_ptr<Section> get_section_by_name(std::string name) {
-        for (auto section : sections) {
-            if (section->get_name() == name)
-                return std::shared_ptr<Section>(section);
+    Section *get_section(u64 index) const {
+        assert(index < sections.size());
+        return &sections[index];
+    }
+
+    Section *get_section_by_name(std::string_view name) const {
+        for (auto &section : sections) {
+            if (section.get_name() == name)
+                return &section;
         }
         return nullptr;
     }
 
-    std::vector<std::shared_ptr<Section>> get_section_starts_with(std::string s) {
-        std::vector<std::shared_ptr<Section>> ret({});
-        for (auto section : sections) {
-            if (section->get_name().starts_with(s))
-                ret.push_back(std::shared_ptr<Section>(section));
+    std::vector<Section *> get_section_starts_with(std::string_view s) const {
+        std::vector<Section *> ret({});
+        for (auto &section : sections) {
+            if (section.get_name().starts_with(s))
+                ret.push_back(&section);
         }
         return ret;
     }
 
-    std::optional<SymTable> get_sym_table() const { return sym_table; }
+    const std::optional<SymTable> &get_sym_table() const { return sym_table; }
 
-    std::shared_ptr<Rela> get_rela_by_name(std::string referent_section) const {
-        if (auto iter = relas.find(referent_section); iter != relas.end()) {
-            return iter->second;
-        }
-        return nullptr;
+    // id in the linked symbol table of the `index`-th symbol of this file.
+    // `kInvalidSymbolId` for section symbols and undefined symbols with no definition
+    SymbolId get_symbol_id(u64 index) const {
+        assert(index < symbol_ids.size());
+        return symbol_ids[index];
+    }
+
+    void set_symbol_id(u64 index, SymbolId id) {
+        assert(index < symbol_ids.size());
+        symbol_ids[index] = id;
     }
 
+    // name of the `index`-th symbol of this file
+    std::string_view get_symbol_name(u64 index) const {
+        assert(index < sym_table->get_symbol_num());
+        return sym_table->get_entries()[index].get_name();
+    }
+
+    // relocation table of the `shndx`-th section, or nullptr if it has no relocations
+    const Rela *get_rela(u64 shndx) const {
+        assert(shndx < relas.size());
+        return relas[shndx];
+    }
+
+    // print headers, symbols and relocations. called for --trace=parse
     void dump() {
         // dump elf header
         fmt::print("ELF type: {}, ", eheader->e_type);
         fmt::print("version: {}\n", eheader->e_version);
 
         // dump sections
-        for (int i = 0; i < sections.size(); i++) {
-            std::shared_ptr<Section> section = sections[i];
+        for (u64 i = 0; i < sections.size(); i++) {
             fmt::print("section[{}] :\n  ", i);
-            fmt::print("name: \"{}\", ", sections[i]->get_name());
-            fmt::print("size: 0x{:x}, ", sections[i]->get_header()->sh_size);
-            fmt::print("entsize: 0x{:x}, ", sections[i]->get_header()->sh_entsize);
-            fmt::print("offset: 0x{:x}, ", sections[i]->get_header()->sh_offset);
-            fmt::print("align: 0x{:x}\n", sections[i]->get_header()->sh_addralign);
+            fmt::print("name: \"{}\", ", sections[i].get_name());
+            fmt::print("size: 0x{:x}, ", sections[i].get_header()->sh_size);
+            fmt::print("entsize: 0x{:x}, ", sections[i].get_header()->sh_entsize);
+            fmt::print("offset: 0x{:x}, ", sections[i].get_header()->sh_offset);
+            fmt::print("align: 0x{:x}\n", sections[i].get_header()->sh_addralign);
         }
 
         // dump symbol table
-        auto symtab_entries = sym_table->get_entries();
-        for (int i = 0; i < sym_table->get_symbol_num(); i++) {
+        auto &symtab_entries = sym_table->get_entries();
+        for (u64 i = 0; i < sym_table->get_symbol_num(); i++) {
             fmt::print("symbol[{}]:\n  ", i);
-            fmt::print("name : \"{}\", ", symtab_entries[i]->get_name());
-            fmt::print("value : 0x{:x}, ", symtab_entries[i]->get_sym()->st_value);
-            fmt::print("info : 0x{:x}\n", symtab_entries[i]->get_sym()->st_info);
+            fmt::print("name : \"{}\", ", symtab_entries[i].get_name());
+            fmt::print("value : 0x{:x}, ", symtab_entries[i].get_sym()->st_value);
+            fmt::print("info : 0x{:x}\n", symtab_entries[i].get_sym()->st_info);
         }
 
-        // dump relocation table (.rela.text)
-        for (auto &[referent_section_name, rela] : relas) {
-            fmt::print("relocation info of \"{}\" (.rela{})\n", referent_section_name, referent_section_name);
+        // dump relocation tables
+        for (u64 shndx = 0; shndx < relas.size(); shndx++) {
+            const Rela *rela = relas[shndx];
+            if (rela == nullptr) {
+                continue;
+            }
+            fmt::print("relocation info of \"{}\" (.rela{})\n", sections[shndx].get_name(), sections[shndx].get_name());
             auto rela_entries = rela->get_entries();
-            for (int i = 0; i < rela->get_reloc_num(); i++) {
+            for (u64 i = 0; i < rela->get_reloc_num(); i++) {
                 fmt::print("rela[{}]:\n  ", i);
-                fmt::print("name : \"{}\", ", rela_entries[i]->get_name());
-                fmt::print("offset : \"{}\", ", rela_entries[i]->get_rela()->r_offset);
-                fmt::print("info : 0x{:x}, ", rela_entries[i]->get_rela()->r_info);
-                fmt::print("addend : {}\n  ", rela_entries[i]->get_rela()->r_addend);
-                fmt::print("sym(in info) : 0x{:x}, ", rela_entries[i]->get_sym());
-                fmt::print("type(in info) : 0x{:x}, \n", rela_entries[i]->get_type());
+                fmt::print("name : \"{}\", ", get_symbol_name(rela_entries[i].get_sym()));
+                fmt::print("offset : \"{}\", ", rela_entries[i].get_rela()->r_offset);
+                fmt::print("info : 0x{:x}, ", rela_entries[i].get_rela()->r_info);
+                fmt::print("addend : {}\n  ", rela_entries[i].get_rela()->r_addend);
+                fmt::print("sym(in info) : 0x{:x}, ", rela_entries[i].get_sym());
+                fmt::print("type(in info) : 0x{:x}, \n", rela_entries[i].get_type());
             }
         }
     }
@@ -340,21 +417,39 @@ class Elf {
   private:
     // use filename as identifier of this structure
     std::string filename;
+    // the input file `raw` is in. kept mapped as long as this elf lives
+    std::shared_ptr<const MappedFile> file;
+    // owns everything parsed from this file
+    Arena arena;
     // raw data
     Raw raw;
     // elf header
     Elf64_Ehdr *eheader;
+    // section name string table
+    Raw shstrtab;
     // program header
     std::vector<Elf64_Phdr *> pheader;
-    // sections
-    std::vector<std::shared_ptr<Section>> sections;
+    // sections, indexed by section header index
+    std::span<Section> sections;
     // symbol table
     // this fielf has some value when the elf contains .symtab section
     std::optional<SymTable> sym_table;
-    // relocation info
-    std::map<std::string, std::shared_ptr<Rela>> relas;
+    // relocation tables, indexed by the section they apply to
+    std::span<Rela *> relas;
+    // result of symbol resolution, indexed by symbol table index
+    std::vector<SymbolId> symbol_ids;
 };
 
+inline std::string_view SymTableEntry::get_name() const { return table->get_name(get_sym()); }
+
+inline std::string_view SymTable::get_name(const Elf64_Sym *sym) const {
+    // the name of a section symbol is the name of its section
+    if (ELF64_ST_TYPE(sym->st_info) == STT_SECTION) {
+        return sections[sym->st_shndx].get_name();
+    }
+    return get_string(strtab, sym->st_name);
+}
+
 } // namespace Parse
 } // namespace Myld
 
@@ -1,9 +1,9 @@
+#include "mapped-file.h"
 #include "myld.h"
 #include "parse-elf.h"
 #include <cassert>
 #include <elf.h>
 #include <fmt/core.h>
-#include <fstream>
 #include <memory>
 #include <string>
 #include <vector>
@@ -12,15 +12,14 @@ namespace Myld::Elf {
 
 class Reader {
   public:
-    Reader(std::string filename) : filename(filename), elf(nullptr) {
-        std::ifstream file(filename);
-        if (!file) {
-            fmt::print("Couldn't open elf file\n");
-            std::exit(1);
-        }
-        auto raw_bytes = std::make_shared<std::vector<u8>>(std::vector<u8>(std::istreambuf_iterator<char>(file), {}));
-
-        elf = std::make_shared<Parse::Elf>(Parse::Elf(filename, raw_bytes));
+    Reader(std::string filename) : Reader(filename, MappedFile::open(filename)) {}
+
+    Reader(std::string filename, std::shared_ptr<const MappedFile> file) : Reader(filename, file, Raw(*file)) {}
+
+    // `raw` is the contents of the object file in `file`, e.g. a member of an archive.
+    // the parsed elf points into `file`, which is kept alive as long as the elf is
+    Reader(std::string filename, std::shared_ptr<const MappedFile> file, Raw raw) : filename(filename), elf(nullptr) {
+        elf = std::make_shared<Parse::Elf>(filename, file, raw);
     }
 
     std::string get_filename() { return filename; }
@@ -0,0 +1,306 @@
+#ifndef RELOCATION_H
+#define RELOCATION_H
+
+#include "context.h"
+#include "log.h"
+#include "myld.h"
+#include "parallel.h"
+#include "parse-elf.h"
+#include "section.h"
+#include <array>
+#include <cstring>
+#include <elf.h>
+#include <fmt/format.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Myld {
+
+// how the value of a relocation is computed (notation of the x86-64 psABI)
+enum class RelocFormula {
+    // S + A
+    Absolute,
+    // S + A - P
+    PcRelative,
+    // G + GOT + A - P
+    GotPcRelative,
+};
+
+// which values fit in the relocated field
+enum class RelocOverflow {
+    // the field is as wide as the value
+    None,
+    // the value must zero-extend from the field
+    Unsigned,
+    // the value must sign-extend from the field
+    Signed,
+};
+
+// description of a relocation type. every kernel is generated from one of these at compile time
+struct RelocDesc {
+    u32 type;
+    const char *name;
+    RelocFormula formula;
+    // size of the relocated field in bytes
+    u8 width;
+    RelocOverflow overflow;
+};
+
+static constexpr RelocDesc kRelocDescs[] = {
+    {R_X86_64_64, "R_X86_64_64", RelocFormula::Absolute, 8, RelocOverflow::None},
+    {R_X86_64_PC32, "R_X86_64_PC32", RelocFormula::PcRelative, 4, RelocOverflow::Signed},
+    // without a PLT, L is the address of the symbol itself
+    {R_X86_64_PLT32, "R_X86_64_PLT32", RelocFormula::PcRelative, 4, RelocOverflow::Signed},
+    {R_X86_64_32, "R_X86_64_32", RelocFormula::Absolute, 4, RelocOverflow::Unsigned},
+    {R_X86_64_32S, "R_X86_64_32S", RelocFormula::Absolute, 4, RelocOverflow::Signed},
+    {R_X86_64_PC64, "R_X86_64_PC64", RelocFormula::PcRelative, 8, RelocOverflow::None},
+    {R_X86_64_GOTPCREL, "R_X86_64_GOTPCREL", RelocFormula::GotPcRelative, 4, RelocOverflow::Signed},
+    // the relaxable variants are applied like GOTPCREL; the instructions are left as they are
+    {R_X86_64_GOTPCRELX, "R_X86_64_GOTPCRELX", RelocFormula::GotPcRelative, 4, RelocOverflow::Signed},
+    {R_X86_64_REX_GOTPCRELX, "R_X86_64_REX_GOTPCRELX", RelocFormula::GotPcRelative, 4, RelocOverflow::Signed},
+};
+
+static constexpr u64 kRelocDescNum = std::size(kRelocDescs);
+
+// index in `kRelocDescs` of each relocation type. -1 if the type is not supported
+static constexpr std::array<i8, R_X86_64_NUM> kRelocDescIndex = []() {
+    std::array<i8, R_X86_64_NUM> index{};
+    index.fill(-1);
+    for (u64 i = 0; i < kRelocDescNum; i++) {
+        index[kRelocDescs[i].type] = i;
+    }
+    return index;
+}();
+
+inline i64 get_reloc_desc_index(u32 type) { return type < R_X86_64_NUM ? kRelocDescIndex[type] : -1; }
+
+inline bool needs_got(u32 type) {
+    i64 index = get_reloc_desc_index(type);
+    return index != -1 && kRelocDescs[index].formula == RelocFormula::GotPcRelative;
+}
+
+// a relocation whose symbol is already resolved
+struct ResolvedRela {
+    // offset of the field in the input section
+    u64 offset;
+    // S, or G + GOT for GOT-relative relocations
+    u64 target;
+    i64 addend;
+};
+
+// apply relocations of one type. the relocations are resolved and bounds-checked beforehand, so the loop has no
+// data-dependent branches. returns false if some value did not fit in its field
+template <u64 DescIndex> static bool apply_batch(u8 *body, u64 addr, const ResolvedRela *relas, u64 n) {
+    constexpr RelocDesc desc = kRelocDescs[DescIndex];
+    static_assert(desc.width == 4 || desc.width == 8);
+
+    bool overflow = false;
+    for (u64 i = 0; i < n; i++) {
+        const ResolvedRela &rela = relas[i];
+        u64 value = rela.target + rela.addend;
+        if constexpr (desc.formula != RelocFormula::Absolute) {
+            value -= addr + rela.offset;
+        }
+
+        if constexpr (desc.width == 8) {
+            std::memcpy(body + rela.offset, &value, sizeof(u64));
+        } else {
+            if constexpr (desc.overflow == RelocOverflow::Signed) {
+                overflow |= (i64)value != (i64)(i32)value;
+            } else if constexpr (desc.overflow == RelocOverflow::Unsigned) {
+                overflow |= (value >> 32) != 0;
+            }
+            u32 field = value;
+            std::memcpy(body + rela.offset, &field, sizeof(u32));
+        }
+    }
+    return !overflow;
+}
+
+typedef bool (*RelocKernel)(u8 *body, u64 addr, const ResolvedRela *relas, u64 n);
+
+template <u64... I>
+static constexpr std::array<RelocKernel, sizeof...(I)> make_reloc_kernels(std::index_sequence<I...>) {
+    return {&apply_batch<I>...};
+}
+
+// specialized kernel of each relocation type, in the order of `kRelocDescs`
+static constexpr std::array<RelocKernel, kRelocDescNum> kRelocKernels =
+    make_reloc_kernels(std::make_index_sequence<kRelocDescNum>());
+
+// relocations of one input section.
+// a task only writes to the bytes of its own input section, so tasks can be processed in parallel
+struct RelocationTask {
+    std::shared_ptr<InputSection> input_section;
+    const Parse::Rela *rela;
+    // contents of the input section in the output file
+    u8 *body;
+    // number of relocations applied
+    u64 applied_num;
+    // problems found while applying. reported after all tasks finish so that the order is deterministic
+    std::vector<std::string> errors;
+    std::vector<std::string> warnings;
+};
+
+// address of the symbol that the `sym_index`-th symbol of the `obj_index`-th object refers to
+static std::optional<u64> get_symbol_addr(const Context &ctx, u64 obj_index, u64 sym_index, i64 addend) {
+    const Parse::Elf &obj = *ctx.objs[obj_index];
+    const Parse::SymTableEntry &sym = obj.get_sym_table()->get_entries()[sym_index];
+    if (sym.get_type() == STT_SECTION) {
+        // the addend selects a fragment of a merged section, which may be anywhere in the output.
+        // S is chosen so that S + A is the address of that fragment
+        u16 shndx = sym.get_sym()->st_shndx;
+        if (ctx.get_mergeable_section(obj_index, shndx) != nullptr) {
+            return ctx.get_merged_addr(obj_index, shndx, addend) - addend;
+        }
+
+        auto input_section = ctx.get_input_section(obj_index, sym.get_sym()->st_shndx);
+        if (input_section == nullptr) {
+            // only unwind tables refer to sections removed by --gc-sections. they get address 0
+            if (!ctx.is_live(obj_index, shndx)) {
+                return 0;
+            }
+            return std::nullopt;
+        }
+        return input_section->get_addr();
+    }
+
+    // local symbols of removed sections are not resolved either
+    if (sym.get_bind() == STB_LOCAL && !ctx.is_live(obj_index, sym.get_sym()->st_shndx)) {
+        return 0;
+    }
+
+    SymbolId symbol_id = obj.get_symbol_id(sym_index);
+    if (symbol_id == kInvalidSymbolId) {
+        // undefined weak symbols resolve to zero
+        if (sym.get_bind() == STB_WEAK) {
+            return 0;
+        }
+        return std::nullopt;
+    }
+    return ctx.linked_sym_table.get_value(symbol_id);
+}
+
+static void apply_relocations(const Context &ctx, RelocationTask &task) {
+    auto rela_entries = task.rela->get_entries();
+    const InputSection &input_section = *task.input_section;
+    std::string_view section_name = input_section.get_name();
+    std::string filename = input_section.get_obj()->get_filename();
+    u64 size = input_section.get_size();
+    u64 addr = input_section.get_addr();
+
+    // resolve every relocation and sort them by type, so that each kernel gets a contiguous batch
+    std::array<u64, kRelocDescNum + 1> batch_starts{};
+    std::vector<i64> desc_indexes(rela_entries.size());
+    for (u64 i = 0; i < rela_entries.size(); i++) {
+        u32 rela_type = rela_entries[i].get_type();
+        desc_indexes[i] = get_reloc_desc_index(rela_type);
+        if (desc_indexes[i] == -1) {
+            // R_X86_64_NONE does nothing by definition
+            if (rela_type != R_X86_64_NONE) {
+                task.warnings.push_back(fmt::format("Not implemented: rela type = 0x{:x}", rela_type));
+            }
+            continue;
+        }
+        batch_starts[desc_indexes[i] + 1]++;
+    }
+    for (u64 i = 0; i < kRelocDescNum; i++) {
+        batch_starts[i + 1] += batch_starts[i];
+    }
+
+    std::vector<ResolvedRela> resolved(batch_starts[kRelocDescNum]);
+    std::array<u64, kRelocDescNum> next = {};
+    std::copy(batch_starts.begin(), batch_starts.end() - 1, next.begin());
+    for (u64 i = 0; i < rela_entries.size(); i++) {
+        if (desc_indexes[i] == -1) {
+            continue;
+        }
+        const RelocDesc &desc = kRelocDescs[desc_indexes[i]];
+        const Elf64_Rela *rela = rela_entries[i].get_rela();
+
+        if (rela->r_offset + desc.width > size) {
+            task.errors.push_back(fmt::format("{} at offset 0x{:x} is out of {} of {}", desc.name, rela->r_offset,
+                                              section_name, filename));
+            continue;
+        }
+
+        u64 target;
+        if (desc.formula == RelocFormula::GotPcRelative) {
+            std::optional<u64> got_entry_addr =
+                ctx.get_got_entry_addr(input_section.get_obj_index(), rela_entries[i].get_sym());
+            if (!got_entry_addr.has_value()) {
+                task.errors.push_back(fmt::format("{} against {} in {} of {} has no GOT entry", desc.name,
+                                                  input_section.get_obj()->get_symbol_name(rela_entries[i].get_sym()),
+                                                  section_name, filename));
+                continue;
+            }
+            target = got_entry_addr.value();
+        } else {
+            std::optional<u64> symbol_addr = get_symbol_addr(ctx, input_section.get_obj_index(),
+                                                              rela_entries[i].get_sym(), rela->r_addend);
+            if (!symbol_addr.has_value()) {
+                task.errors.push_back(fmt::format("undefined symbol: {} (referenced from {} of {})",
+                                                  input_section.get_obj()->get_symbol_name(rela_entries[i].get_sym()),
+                                                  section_name, filename));
+                continue;
+            }
+            target = symbol_addr.value();
+        }
+        MYLD_TRACE(Reloc, "{}: {} at {}+0x{:x} against {} = 0x{:x}\n", filename, desc.name, section_name,
+                   rela->r_offset, input_section.get_obj()->get_symbol_name(rela_entries[i].get_sym()), target);
+        resolved[next[desc_indexes[i]]++] = ResolvedRela{rela->r_offset, target, rela->r_addend};
+    }
+
+    for (u64 i = 0; i < kRelocDescNum; i++) {
+        // skipped relocations leave a hole at the end of their batch
+        u64 n = next[i] - batch_starts[i];
+        if (n == 0) {
+            continue;
+        }
+        if (!kRelocKernels[i](task.body, addr, &resolved[batch_starts[i]], n)) {
+            task.errors.push_back(fmt::format("{} relocation out of range in {} of {}", kRelocDescs[i].name,
+                                              section_name, filename));
+            continue;
+        }
+        task.applied_num += n;
+    }
+}
+
+// apply the relocations of every input section in the output file mapped at `buf`, and count them in `applied_num`.
+// returns false if some relocation could not be applied
+static bool apply_all_relocations(const Context &ctx, u8 *buf, u64 &applied_num) {
+    std::vector<RelocationTask> tasks;
+    for (auto &output_section : ctx.output_sections) {
+        for (auto &input_section : output_section->get_members()) {
+            auto rela = input_section->get_obj()->get_rela(input_section->get_shndx());
+            if (rela != nullptr) {
+                u8 *body = buf + output_section->get_offset() + input_section->get_offset();
+                tasks.push_back(RelocationTask{input_section, rela, body, 0, {}, {}});
+            }
+        }
+    }
+    Parallel::parallel_for(ctx.config.get_num_threads(), tasks.size(), [&](u64 i) {
+        ScopedTimer timer(ctx.time_trace, "relocate section", tasks[i].input_section->get_name());
+        apply_relocations(ctx, tasks[i]);
+    });
+
+    bool ok = true;
+    applied_num = 0;
+    for (auto &task : tasks) {
+        applied_num += task.applied_num;
+        for (auto &warning : task.warnings) {
+            fmt::print("{}\n", warning);
+        }
+        for (auto &error : task.errors) {
+            fmt::print("{}\n", error);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+} // namespace Myld
+
+#endif
@@ -0,0 +1,147 @@
+#include "context.h"
+#include "linked-sym-table.h"
+#include "parallel.h"
+#include <fmt/format.h>
+
+namespace Myld {
+
+// whether the symbol takes part in global symbol resolution
+static bool is_global_definition(const Parse::SymTableEntry &sym) {
+    return sym.get_bind() != STB_LOCAL && sym.get_sym()->st_shndx != SHN_UNDEF;
+}
+
+// rank of a global definition in the symbol table
+static u64 get_rank(const Parse::SymTableEntry &sym, u64 file_index, u64 sym_index) {
+    return LinkedSymTable::make_rank(sym.get_bind() == STB_WEAK, sym.get_sym()->st_shndx == SHN_COMMON, file_index,
+                                     sym_index);
+}
+
+// whether the symbol gets its own entry in the linked symbol table without resolution
+static bool is_local_definition(const Parse::SymTableEntry &sym) {
+    return sym.get_bind() == STB_LOCAL && sym.get_sym()->st_shndx != SHN_UNDEF && sym.get_type() != STT_SECTION;
+}
+
+void Context::resolve_symbols() {
+    u64 num_threads = this->config.get_num_threads();
+    u64 obj_num = this->objs.size();
+
+    u64 total_symbol_num = 0;
+    for (auto obj : this->objs) {
+        total_symbol_num += obj->get_sym_table()->get_symbol_num();
+    }
+    this->linked_sym_table.reserve(total_symbol_num);
+
+    // every global definition claims its name. the table keeps the definition with the lowest rank
+    Parallel::parallel_for(num_threads, obj_num, [&](u64 file_index) {
+        auto &sym_entries = this->objs[file_index]->get_sym_table()->get_entries();
+        for (u64 i = 1; i < sym_entries.size(); i++) {
+            const Parse::SymTableEntry &sym = sym_entries[i];
+            if (is_global_definition(sym)) {
+                u64 rank = get_rank(sym, file_index, i);
+                this->linked_sym_table.claim(&sym, rank);
+            }
+        }
+    });
+
+    // count the symbols each file contributes and detect duplicated strong definitions
+    std::vector<u64> symbol_counts(obj_num, 0);
+    std::vector<std::vector<std::string>> errors(obj_num);
+    Parallel::parallel_for(num_threads, obj_num, [&](u64 file_index) {
+        auto obj = this->objs[file_index];
+        auto &sym_entries = obj->get_sym_table()->get_entries();
+        for (u64 i = 1; i < sym_entries.size(); i++) {
+            const Parse::SymTableEntry &sym = sym_entries[i];
+            if (is_local_definition(sym)) {
+                symbol_counts[file_index]++;
+            } else if (is_global_definition(sym)) {
+                u64 rank = get_rank(sym, file_index, i);
+                u64 winner = this->linked_sym_table.get_rank(sym.get_name(), sym.get_name_hash());
+                if (winner == rank) {
+                    symbol_counts[file_index]++;
+                } else if (!LinkedSymTable::rank_is_weak(rank) && !LinkedSymTable::rank_is_weak(winner) &&
+                           !LinkedSymTable::rank_is_common(rank) && !LinkedSymTable::rank_is_common(winner)) {
+                    auto winner_obj = this->objs[LinkedSymTable::rank_file_index(winner)];
+                    errors[file_index].push_back(fmt::format("duplicated symbol: {} (defined in {} and {})",
+                                                             sym.get_name(), winner_obj->get_filename(),
+                                                             obj->get_filename()));
+                }
+            }
+        }
+    });
+
+    // report errors in input order so that the message does not depend on thread timing
+    bool has_error = false;
+    for (auto &file_errors : errors) {
+        for (auto &error : file_errors) {
+            fmt::print("{}\n", error);
+            has_error = true;
+        }
+    }
+    if (has_error) {
+        std::exit(1);
+    }
+
+    // ids are given file by file in input order
+    std::vector<SymbolId> first_ids(obj_num);
+    u64 next_id = this->linked_sym_table.get_symbol_num();
+    for (u64 file_index = 0; file_index < obj_num; file_index++) {
+        first_ids[file_index] = next_id;
+        next_id += symbol_counts[file_index];
+    }
+    assert(next_id < kInvalidSymbolId);
+    this->linked_sym_table.resize(next_id);
+
+    // create linked symbols of local symbols and winning global symbols
+    Parallel::parallel_for(num_threads, obj_num, [&](u64 file_index) {
+        auto obj = this->objs[file_index];
+        auto &sym_entries = obj->get_sym_table()->get_entries();
+        SymbolId id = first_ids[file_index];
+        for (u64 i = 1; i < sym_entries.size(); i++) {
+            const Parse::SymTableEntry &sym = sym_entries[i];
+            bool is_winner = false;
+            if (is_global_definition(sym)) {
+                u64 rank = get_rank(sym, file_index, i);
+                is_winner = this->linked_sym_table.get_rank(sym.get_name(), sym.get_name_hash()) == rank;
+            }
+            if (is_local_definition(sym) || is_winner) {
+                this->linked_sym_table.set_symbol(id, sym, file_index);
+                obj->set_symbol_id(i, id);
+                id++;
+            }
+        }
+        assert(id == first_ids[file_index] + symbol_counts[file_index]);
+    });
+
+    // bind undefined symbols and losing definitions to the winners
+    Parallel::parallel_for(num_threads, obj_num, [&](u64 file_index) {
+        auto obj = this->objs[file_index];
+        auto &sym_entries = obj->get_sym_table()->get_entries();
+        for (u64 i = 1; i < sym_entries.size(); i++) {
+            const Parse::SymTableEntry &sym = sym_entries[i];
+            if (sym.get_bind() != STB_LOCAL && obj->get_symbol_id(i) == kInvalidSymbolId) {
+                obj->set_symbol_id(i, this->linked_sym_table.find(sym.get_name(), sym.get_name_hash()));
+            }
+        }
+    });
+
+    // COMMON symbols of the same name are merged into the winner, which takes the largest size and alignment.
+    // st_value of a COMMON symbol is its alignment. a real definition of the name overrides all of them
+    LinkedSymTable &symbols = this->linked_sym_table;
+    for (u64 file_index = 0; file_index < obj_num; file_index++) {
+        auto obj = this->objs[file_index];
+        auto &sym_entries = obj->get_sym_table()->get_entries();
+        for (u64 i = 1; i < sym_entries.size(); i++) {
+            const Parse::SymTableEntry &sym = sym_entries[i];
+            if (sym.get_bind() == STB_LOCAL || sym.get_sym()->st_shndx != SHN_COMMON) {
+                continue;
+            }
+            SymbolId winner = obj->get_symbol_id(i);
+            if (symbols.get_shndx(winner) == SHN_COMMON) {
+                symbols.set_size(winner, std::max(symbols.get_size(winner), sym.get_sym()->st_size));
+                symbols.set_value(winner, std::max(symbols.get_value(winner), sym.get_sym()->st_value));
+            }
+        }
+    }
+}
+
+} // namespace Myld
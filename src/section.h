@@ -0,0 +1,223 @@
+#ifndef SECTION_H
+#define SECTION_H
+
+#include "myld.h"
+#include "parse-elf.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <elf.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Myld {
+
+class OutputSection;
+
+// an input section placed in the output.
+// only a view into the input file and the place in the output section are kept. the bytes are copied once,
+// straight into the output file, and relocated there
+class InputSection {
+  public:
+    InputSection(std::shared_ptr<Parse::Elf> obj, u32 obj_index, u32 shndx)
+        : obj(obj), obj_index(obj_index), shndx(shndx), section(obj->get_section(shndx)), output_section(nullptr),
+          offset(0) {}
+
+    std::shared_ptr<Parse::Elf> get_obj() const { return obj; }
+
+    // index of the object file in `Context::objs`
+    u32 get_obj_index() const { return obj_index; }
+
+    u32 get_shndx() const { return shndx; }
+
+    const Parse::Section *get_section() const { return section; }
+
+    std::string_view get_name() const { return section->get_name(); }
+
+    Raw get_raw() const { return section->get_raw(); }
+
+    u64 get_size() const { return section->get_header()->sh_size; }
+
+    u64 get_align() const { return std::max<u64>(section->get_header()->sh_addralign, 1); }
+
+    OutputSection *get_output_section() const { return output_section; }
+
+    // offset from the start of the output section
+    u64 get_offset() const { return offset; }
+
+    void place(OutputSection *output_section_, u64 offset_) {
+        output_section = output_section_;
+        offset = offset_;
+    }
+
+    // address in the output
+    u64 get_addr() const;
+
+  private:
+    std::shared_ptr<Parse::Elf> obj;
+    u32 obj_index;
+    u32 shndx;
+    // owned by `obj`
+    const Parse::Section *section;
+    OutputSection *output_section;
+    u64 offset;
+};
+
+// a section of the output file, made of input sections and/or content generated by the linker (e.g. .got)
+class OutputSection {
+  public:
+    OutputSection(std::string name, u32 type, u64 flags, u64 align)
+        : name(name), type(type), flags(flags), align(align), addr(0), size(0), offset(0) {}
+
+    std::string get_name() const { return name; }
+
+    u32 get_type() const { return type; }
+
+    u64 get_flags() const { return flags; }
+
+    // the largest alignment of the members
+    u64 get_align() const { return align; }
+
+    u64 get_addr() const { return addr; }
+
+    void set_addr(u64 addr_) { addr = addr_; }
+
+    u64 get_size() const { return size; }
+
+    // offset in the output file. decided by the builder
+    u64 get_offset() const { return offset; }
+
+    void set_offset(u64 offset_) { offset = offset_; }
+
+    const std::vector<std::shared_ptr<InputSection>> &get_members() const { return members; }
+
+    // add an input section at the end of this section. it is placed by `assign_offsets()`.
+    // the section is writable or executable if any member is, and occupies the file if any member does
+    void append(std::shared_ptr<InputSection> member) {
+        const Elf64_Shdr *header = member->get_section()->get_header();
+        align = std::max(align, member->get_align());
+        flags |= header->sh_flags & (SHF_ALLOC | SHF_WRITE | SHF_EXECINSTR | SHF_TLS);
+        if (type == SHT_NOBITS && header->sh_type != SHT_NOBITS) {
+            type = header->sh_type;
+        }
+        members.push_back(member);
+    }
+
+    // reorder the members by `priority(member)`, lower first. members of the same priority keep their order.
+    // must be called before `assign_offsets()`
+    template <typename F> void sort_members(F priority) {
+        std::stable_sort(members.begin(), members.end(),
+                         [&](const auto &a, const auto &b) { return priority(*a) < priority(*b); });
+    }
+
+    // place the members back to back after the content, each aligned to its sh_addralign, and decide the size of
+    // this section.
+    // the members are split into chunks which are laid out in parallel from offset 0, then shifted by a prefix sum
+    // of the chunk sizes. a chunk starts at a multiple of its largest member alignment, so the shift keeps every
+    // member aligned
+    void assign_offsets(u64 num_threads) {
+        constexpr u64 kChunkSize = 1024;
+        u64 chunk_num = (members.size() + kChunkSize - 1) / kChunkSize;
+        std::vector<u64> chunk_sizes(chunk_num);
+        std::vector<u64> chunk_aligns(chunk_num);
+        Parallel::parallel_for(num_threads, chunk_num, [&](u64 c) {
+            u64 offset = 0;
+            u64 chunk_align = 1;
+            for (u64 i = c * kChunkSize; i < std::min((c + 1) * kChunkSize, (u64)members.size()); i++) {
+                u64 member_align = members[i]->get_align();
+                offset = align_to(offset, member_align);
+                members[i]->place(this, offset);
+                offset += members[i]->get_size();
+                chunk_align = std::max(chunk_align, member_align);
+            }
+            chunk_sizes[c] = offset;
+            chunk_aligns[c] = chunk_align;
+        });
+
+        std::vector<u64> chunk_starts(chunk_num);
+        size = content.size();
+        for (u64 c = 0; c < chunk_num; c++) {
+            chunk_starts[c] = align_to(size, chunk_aligns[c]);
+            size = chunk_starts[c] + chunk_sizes[c];
+        }
+
+        Parallel::parallel_for(num_threads, chunk_num, [&](u64 c) {
+            for (u64 i = c * kChunkSize; i < std::min((c + 1) * kChunkSize, (u64)members.size()); i++) {
+                members[i]->place(this, chunk_starts[c] + members[i]->get_offset());
+            }
+        });
+    }
+
+    // reserve `size_` zero bytes aligned to `align_` at the end of this section, after the members placed by
+    // `assign_offsets()`. used for COMMON symbols, which have no input section. returns the offset of the space
+    u64 allocate(u64 size_, u64 align_) {
+        align = std::max(align, align_);
+        u64 offset_ = align_to(size, align_);
+        size = offset_ + size_;
+        return offset_;
+    }
+
+    // linker-generated bytes at the start of this section (e.g. merged strings), followed by the members
+    const std::vector<u8> &get_content() const { return content; }
+
+    std::vector<u8> &get_mutable_content() { return content; }
+
+    void set_content(std::vector<u8> content_) {
+        assert(members.empty());
+        content = std::move(content_);
+        size = content.size();
+    }
+
+  private:
+    std::string name;
+    u32 type;
+    u64 flags;
+    u64 align;
+    u64 addr;
+    u64 size;
+    u64 offset;
+    std::vector<std::shared_ptr<InputSection>> members;
+    std::vector<u8> content;
+};
+
+// name of the output section which an input section named `name` goes to.
+// e.g. .text.foo goes to .text. the prefixes are the ones of the default linker script of GNU ld and lld
+inline std::string get_output_section_name(std::string_view name) {
+    static const char *prefixes[] = {
+        ".text.",  ".rodata.", ".data.rel.ro.", ".data.",       ".bss.rel.ro.", ".bss.",       ".tdata.",
+        ".tbss.",  ".ldata.",  ".lrodata.",     ".lbss.",       ".init_array.", ".fini_array.", ".gcc_except_table.",
+    };
+    for (const char *prefix : prefixes) {
+        std::string_view stem(prefix, std::strlen(prefix) - 1);
+        if (name.starts_with(prefix) || name == stem) {
+            return std::string(stem);
+        }
+    }
+    return std::string(name);
+}
+
+// whether the section holds unwind tables. a FDE refers to the function it describes, but neither calls it nor takes
+// its address
+inline bool is_unwind_section(const Parse::Section &section) {
+    return section.get_header()->sh_type == SHT_X86_64_UNWIND || section.get_name() == ".eh_frame";
+}
+
+// p_flags of the PT_LOAD segment which loads an output section: read-only data, code, or writable data
+inline u32 get_segment_flags(const OutputSection &output_section) {
+    if (output_section.get_flags() & SHF_EXECINSTR) {
+        return PF_R | PF_X;
+    }
+    return (output_section.get_flags() & SHF_WRITE) ? (PF_R | PF_W) : PF_R;
+}
+
+inline u64 InputSection::get_addr() const {
+    assert(output_section != nullptr);
+    return output_section->get_addr() + offset;
+}
+
+} // namespace Myld
+
+#endif
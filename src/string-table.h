@@ -0,0 +1,116 @@
+#ifndef STRING_TABLE_H
+#define STRING_TABLE_H
+
+#include "myld.h"
+#include "parallel.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace Myld {
+
+// contents of an ELF string table (.strtab, .shstrtab). a string is stored once however many times it is given, and a
+// string which is the tail of a longer one (".text" of ".rela.text") is not stored at all but points into it.
+//
+// a string can only share bytes with strings ending with the same character, so strings are grouped by their last
+// character and every group is laid out on its own thread. sorted by their reversed bytes in descending order, the
+// strings a string is the tail of come right before it, so it is enough to compare it with the one before
+class StringTable {
+  public:
+    // lay out `strings`, which must outlive the table. `get_offset(i)` is where `strings[i]` is
+    StringTable(std::span<const std::string_view> strings, u64 num_threads)
+        : strings(strings), offsets(strings.size(), 0), owners(), size(0) {
+        // the empty string is the NUL at offset 0 every string table starts with
+        std::array<std::vector<u32>, kGroupNum> groups;
+        for (u64 i = 0; i < strings.size(); i++) {
+            if (!strings[i].empty()) {
+                groups[(u8)strings[i].back()].push_back(i);
+            }
+        }
+
+        // offsets are relative to the start of the group first
+        std::array<u64, kGroupNum> group_sizes{};
+        Parallel::parallel_for(num_threads, kGroupNum, [&](u64 g) {
+            std::vector<u32> &group = groups[g];
+            std::sort(group.begin(), group.end(),
+                      [&](u32 a, u32 b) { return reversed_greater(this->strings[a], this->strings[b]); });
+            std::string_view prev;
+            u64 prev_offset = 0;
+            for (u32 i : group) {
+                std::string_view s = this->strings[i];
+                if (prev.ends_with(s)) {
+                    offsets[i] = prev_offset + prev.size() - s.size();
+                    continue;
+                }
+                prev = s;
+                prev_offset = group_sizes[g];
+                offsets[i] = prev_offset;
+                owners[g].push_back(i);
+                group_sizes[g] += s.size() + 1;
+            }
+        });
+
+        std::array<u64, kGroupNum> group_offsets;
+        size = 1;
+        for (u64 g = 0; g < kGroupNum; g++) {
+            group_offsets[g] = size;
+            size += group_sizes[g];
+        }
+        assert(size <= UINT32_MAX);
+        Parallel::parallel_for(num_threads, kGroupNum, [&](u64 g) {
+            for (u32 i : groups[g]) {
+                offsets[i] += group_offsets[g];
+            }
+        });
+    }
+
+    // offset of the `index`-th string
+    u32 get_offset(u64 index) const {
+        assert(index < offsets.size());
+        return offsets[index];
+    }
+
+    u64 get_size() const { return size; }
+
+    // write the table to `buf`, which has `get_size()` bytes
+    void write(u64 num_threads, u8 *buf) const {
+        buf[0] = '\0';
+        Parallel::parallel_for(num_threads, kGroupNum, [&](u64 g) {
+            for (u32 i : owners[g]) {
+                std::memcpy(buf + offsets[i], strings[i].data(), strings[i].size());
+                buf[offsets[i] + strings[i].size()] = '\0';
+            }
+        });
+    }
+
+  private:
+    // strings are grouped by their last byte
+    static constexpr u64 kGroupNum = 256;
+
+    std::span<const std::string_view> strings;
+    std::vector<u32> offsets;
+    // strings whose bytes are in the table, by group. the others point into one of them
+    std::array<std::vector<u32>, kGroupNum> owners;
+    u64 size;
+
+    // whether `a` comes before `b` when both are read backwards, a longer string first if one is the tail of the other
+    static bool reversed_greater(std::string_view a, std::string_view b) {
+        const u8 *end_a = (const u8 *)a.data() + a.size();
+        const u8 *end_b = (const u8 *)b.data() + b.size();
+        u64 n = std::min(a.size(), b.size());
+        for (u64 i = 1; i <= n; i++) {
+            if (end_a[-i] != end_b[-i]) {
+                return end_a[-i] > end_b[-i];
+            }
+        }
+        return a.size() > b.size();
+    }
+};
+
+} // namespace Myld
+
+#endif
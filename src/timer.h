@@ -0,0 +1,162 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "myld.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fmt/core.h>
+#include <fmt/format.h>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <sys/resource.h>
+#include <vector>
+
+namespace Myld {
+
+// durations of the phases of a link, for --time-trace and --stats.
+// nothing is recorded unless `enable()` is called, so timers cost one branch in a normal run
+class TimeTrace {
+  public:
+    struct Event {
+        std::string name;
+        // e.g. the file being parsed. empty for phases
+        std::string detail;
+        u64 start_us;
+        u64 duration_us;
+        // `Parallel::current_worker_index` of the thread, shown as a separate track
+        u32 worker;
+        // number of enclosing timers on the same thread
+        u32 depth;
+    };
+
+    TimeTrace() : enabled(false), start(std::chrono::steady_clock::now()) {}
+
+    void enable() { enabled = true; }
+
+    bool is_enabled() const { return enabled; }
+
+    // microseconds since the trace was created
+    u64 now_us() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start)
+            .count();
+    }
+
+    // safe to call from multiple threads at once
+    void record(Event event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(std::move(event));
+    }
+
+    // events sorted by start time
+    std::vector<Event> get_events() const {
+        std::vector<Event> sorted = events;
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [](const Event &a, const Event &b) { return a.start_us < b.start_us; });
+        return sorted;
+    }
+
+    // write the events in the Chrome trace event format, which chrome://tracing and Perfetto can show
+    void write_json(std::string filename) const {
+        std::FILE *file = std::fopen(filename.c_str(), "w");
+        if (file == nullptr) {
+            fmt::print("Couldn't open {}\n", filename);
+            std::exit(1);
+        }
+        u32 worker_num = 0;
+        fmt::print(file, "{{\"traceEvents\":[\n");
+        for (auto &event : get_events()) {
+            fmt::print(file,
+                       "{{\"name\":\"{}\",\"cat\":\"myld\",\"ph\":\"X\",\"ts\":{},\"dur\":{},\"pid\":1,\"tid\":{},"
+                       "\"args\":{{\"detail\":\"{}\"}}}},\n",
+                       escape(event.name), event.start_us, event.duration_us, event.worker, escape(event.detail));
+            worker_num = std::max(worker_num, event.worker + 1);
+        }
+        for (u32 worker = 0; worker < worker_num; worker++) {
+            std::string name = worker == 0 ? "main" : fmt::format("worker {}", worker);
+            fmt::print(file,
+                       "{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}{}\n",
+                       worker, name, worker + 1 < worker_num ? "," : "");
+        }
+        fmt::print(file, "],\"displayTimeUnit\":\"ms\"}}\n");
+        std::fclose(file);
+    }
+
+  private:
+    bool enabled;
+    std::chrono::steady_clock::time_point start;
+    std::mutex mutex;
+    std::vector<Event> events;
+
+    static std::string escape(const std::string &s) {
+        std::string escaped;
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += c;
+            } else if ((u8)c < 0x20) {
+                escaped += fmt::format("\\u{:04x}", (u8)c);
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+};
+
+// times the scope it lives in. e.g. `ScopedTimer timer(ctx.time_trace, "resolve symbols");`
+class ScopedTimer {
+  public:
+    ScopedTimer(TimeTrace &trace, std::string_view name, std::string_view detail = "") : trace(trace), start_us(0) {
+        if (trace.is_enabled()) {
+            this->name = name;
+            this->detail = detail;
+            start_us = trace.now_us();
+            depth++;
+        }
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    ~ScopedTimer() {
+        if (trace.is_enabled()) {
+            depth--;
+            trace.record(TimeTrace::Event{name, detail, start_us, trace.now_us() - start_us,
+                                          Parallel::current_worker_index, depth});
+        }
+    }
+
+  private:
+    TimeTrace &trace;
+    std::string name;
+    std::string detail;
+    u64 start_us;
+
+    static inline thread_local u32 depth = 0;
+};
+
+// counters shown by --stats
+struct Stats {
+    // total size of the input files, including archive members which are not loaded
+    u64 input_bytes = 0;
+    u64 input_file_num = 0;
+    u64 output_bytes = 0;
+    u64 relocation_num = 0;
+};
+
+// peak resident set size of this process in bytes
+inline u64 get_peak_rss() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // ru_maxrss is in KiB on Linux
+    return (u64)usage.ru_maxrss * 1024;
+}
+
+} // namespace Myld
+
+#endif
@@ -37,3 +37,20 @@ test_exec "simple3"
 test_exec "static1"
 test_exec "static2"
 test_exec "static3"
+test_exec "weak1"
+test_exec "archive1"
+test_exec "gc1"
+test_exec "align1"
+test_exec "icf1"
+test_exec "merge1"
+test_exec "segment1"
+test_exec "common1"
+test_exec "order1"
+test_exec "cgsort1"
+test_exec "longname1"
+test_exec "strtab1"
+test_exec "icf2"
+test_exec "gc2"
+test_exec "flags1"
+test_exec "got1"
+test_exec "symtab1"
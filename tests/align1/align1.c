@@ -0,0 +1,19 @@
+extern char c;
+extern const long aligned_table[4];
+extern long aligned_data[2];
+long sub(long x);
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    // every input section must be placed at a multiple of its alignment
+    long status = sub(c) - 3;
+    status += (long)aligned_table % 64 != 0;
+    status += (long)aligned_data % 32 != 0;
+    status += aligned_table[3] - 4;
+    status += aligned_data[1] - 6;
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}
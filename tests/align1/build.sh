@@ -0,0 +1,6 @@
+cd `dirname $0`
+LD=$1
+
+cc align1.c -c -o align1.o -m64 -fno-asynchronous-unwind-tables -g0 -ffunction-sections -fdata-sections
+cc sub.c -c -o sub.o -m64 -fno-asynchronous-unwind-tables -g0 -ffunction-sections -fdata-sections
+$LD align1.o sub.o -T align1.ld -nostdlib
@@ -0,0 +1,8 @@
+// odd-sized sections before the aligned ones
+char c = 1;
+const char s[3] = "ab";
+
+_Alignas(64) const long aligned_table[4] = {1, 2, 3, 4};
+_Alignas(32) long aligned_data[2] = {5, 6};
+
+__attribute__((aligned(32))) long sub(long x) { return x + s[0] - 'a' + 2; }
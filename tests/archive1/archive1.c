@@ -0,0 +1,15 @@
+int g();
+
+// also defined in unused.o, which must not be pulled out of libfoo.a
+int f() { return 1; }
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    // exit(g() - 42)
+    long status = g() - 42 + f() - 1;
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}
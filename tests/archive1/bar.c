@@ -0,0 +1,3 @@
+int h();
+
+int g() { return h() + 2; }
@@ -0,0 +1,13 @@
+cd `dirname $0`
+LD=$1
+
+cc archive1.c -c -o archive1.o -m64 -fno-asynchronous-unwind-tables -g0
+cc foo.c -c -o foo.o -m64 -fno-asynchronous-unwind-tables -g0
+cc bar.c -c -o bar.o -m64 -fno-asynchronous-unwind-tables -g0
+cc unused.c -c -o unused.o -m64 -fno-asynchronous-unwind-tables -g0
+rm -f libfoo.a libbar.a
+ar rcs libfoo.a foo.o unused.o
+# thin archive
+ar rcsT libbar.a bar.o
+# libbar.a needs a member of libfoo.a, which comes first
+$LD archive1.o --start-group libfoo.a libbar.a --end-group -T archive1.ld -nostdlib
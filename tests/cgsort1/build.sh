@@ -0,0 +1,16 @@
+cd `dirname $0`
+LD=$1
+
+# GNU ld has no --call-graph-profile-sort
+ORDER_FLAGS=""
+CFLAGS=""
+case $LD in
+*myld)
+    ORDER_FLAGS="--call-graph-profile-sort"
+    CFLAGS="-DSORTED"
+    ;;
+esac
+
+cc cgsort1.c -c -o cgsort1.o -m64 -fno-asynchronous-unwind-tables -g0 -O1 -ffunction-sections $CFLAGS
+as profile.s -o profile.o
+$LD cgsort1.o profile.o $ORDER_FLAGS -T cgsort1.ld -nostdlib
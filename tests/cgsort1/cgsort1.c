@@ -0,0 +1,21 @@
+__attribute__((noinline)) int cold1() { return 1; }
+__attribute__((noinline)) int hot1() { return 2; }
+__attribute__((noinline)) int cold2() { return 3; }
+__attribute__((noinline)) int hot2() { return hot1() + 1; }
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    // volatile, or the compiler assumes the order of the functions
+    unsigned long volatile addrs[] = {(unsigned long)cold1, (unsigned long)hot1, (unsigned long)cold2,
+                                      (unsigned long)hot2, (unsigned long)_start};
+    long status = cold1() + hot2() + cold2() - 7;
+#ifdef SORTED
+    // the hot path _start -> hot2 -> hot1 is packed together, rarely called functions follow
+    status += !(addrs[4] < addrs[3] && addrs[3] < addrs[1] && addrs[1] < addrs[0] && addrs[0] < addrs[2]);
+#endif
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}
@@ -0,0 +1,12 @@
+# a call graph profile in the format of clang -fprofile-use: the weights of the edges, and an R_X86_64_NONE
+# relocation to the caller and one to the callee of each edge
+.section .llvm.call-graph-profile,"e",@1879002121
+.reloc ., R_X86_64_NONE, _start
+.reloc ., R_X86_64_NONE, hot2
+.quad 1000
+.reloc ., R_X86_64_NONE, hot2
+.reloc ., R_X86_64_NONE, hot1
+.quad 900
+.reloc ., R_X86_64_NONE, _start
+.reloc ., R_X86_64_NONE, cold1
+.quad 1
@@ -1,2 +1,2 @@
 cd `dirname $0`
-rm ./*/*.o ./*/*.out ./*/*.log 2> /dev/null
+rm ./*/*.o ./*/*.a ./*/*.out ./*/*.log 2> /dev/null
@@ -0,0 +1,6 @@
+cd `dirname $0`
+LD=$1
+
+cc common1.c -c -o common1.o -m64 -fno-asynchronous-unwind-tables -g0 -O1 -fcommon
+cc table.c -c -o table.o -m64 -fno-asynchronous-unwind-tables -g0 -O1 -fcommon
+$LD common1.o table.o -T common1.ld -nostdlib
@@ -0,0 +1,25 @@
+// COMMON symbols, merged with the ones of table.c
+long table[16];
+long counter;
+
+extern char big[];
+long *get_table();
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    long status = 0;
+    // both files see the same objects, with the largest size and alignment
+    status += table != get_table();
+    status += ((unsigned long)table & 63) != 0;
+    table[1023] = 42;
+    counter = table[1023];
+    status += get_table()[1023] != 42 || table[0] != 0 || counter != 42;
+    // .bss is zero-filled and writable up to its end
+    status += big[0] != 0 || big[(64 << 20) - 1] != 0;
+    big[(64 << 20) - 1] = 1;
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}
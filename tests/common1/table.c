@@ -0,0 +1,8 @@
+// COMMON symbols. `table` is larger and more aligned here than in common1.c
+__attribute__((aligned(64))) long table[1024];
+long counter;
+
+// 64 MiB of zeros, which must not be written to the output file
+char big[64 << 20] = {0};
+
+long *get_table() { return table; }
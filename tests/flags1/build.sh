@@ -0,0 +1,6 @@
+cd `dirname $0`
+LD=$1
+
+cc first.c -c -o first.o -m64 -fno-asynchronous-unwind-tables -g0 -fdata-sections
+cc flags1.c -c -o flags1.o -m64 -fno-asynchronous-unwind-tables -g0 -fdata-sections
+$LD first.o flags1.o -T flags1.ld -nostdlib
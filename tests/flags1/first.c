@@ -0,0 +1,7 @@
+// linked first, so these create the output sections mysec (read-only) and .bss (SHT_NOBITS)
+asm(".section mysec,\"a\",@progbits\n"
+    ".globl ro\n"
+    ".p2align 2\n"
+    "ro: .long 1\n"
+    ".previous\n");
+int zero;
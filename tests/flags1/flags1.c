@@ -0,0 +1,31 @@
+extern const int ro;
+extern int zero;
+extern int counter;
+extern int initialized;
+
+// writable, in the output section mysec made read-only by first.c
+asm(".section mysec,\"aw\",@progbits\n"
+    ".globl counter\n"
+    ".p2align 2\n"
+    "counter: .long 2\n"
+    ".previous\n");
+
+// initialized, in the output section .bss made of SHT_NOBITS sections by first.c
+asm(".section .bss.initialized,\"aw\",@progbits\n"
+    ".globl initialized\n"
+    ".p2align 2\n"
+    "initialized: .long 5\n"
+    ".previous\n");
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    counter += ro;
+    zero += 1;
+    // exit(3 + 1 + 5 - 9)
+    long status = counter + zero + initialized - 9;
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}
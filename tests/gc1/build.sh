@@ -0,0 +1,6 @@
+cd `dirname $0`
+LD=$1
+
+cc gc1.c -c -o gc1.o -m64 -fno-asynchronous-unwind-tables -g0 -ffunction-sections -fdata-sections
+# unused() refers to an undefined symbol, so the link fails unless its section is removed
+$LD gc1.o --gc-sections -T gc1.ld -nostdlib
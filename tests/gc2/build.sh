@@ -0,0 +1,13 @@
+cd `dirname $0`
+LD=$1
+
+cc gc2.c -c -o gc2.o -m64 -g0 -ffunction-sections -fdata-sections
+# unused() refers to an undefined symbol, so the link fails unless its section is removed
+$LD gc2.o --gc-sections -T gc2.ld -nostdlib || exit 1
+
+# the unwind tables are kept
+case $LD in
+*myld)
+    readelf -SW myld-a.out | grep -q " \.eh_frame " || exit 1
+    ;;
+esac
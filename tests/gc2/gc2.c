@@ -0,0 +1,20 @@
+// built with unwind tables: .eh_frame has a FDE for unused(), which must neither keep it alive nor be removed
+int missing();
+
+int table[4] = {1, 2, 3, 4};
+int unused_table[4] = {5, 6, 7, 8};
+
+int used() { return table[3]; }
+
+int unused() { return missing() + unused_table[0]; }
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    // exit(used() - 4)
+    long status = used() - 4;
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}
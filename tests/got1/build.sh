@@ -0,0 +1,5 @@
+cd `dirname $0`
+LD=$1
+
+cc got1.c -c -o got1.o -m64 -fno-asynchronous-unwind-tables -g0
+$LD got1.o -T got1.ld -nostdlib
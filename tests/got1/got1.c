@@ -0,0 +1,29 @@
+// GOT-relative loads of symbols without a linked symbol: an undefined weak symbol and a section symbol
+asm(".weak missing\n"
+    ".section .rodata.got1,\"a\"\n"
+    ".p2align 3\n"
+    ".quad 42\n"
+    ".text\n");
+
+static long load_missing(void) {
+    long *p;
+    asm volatile("movq missing@GOTPCREL(%%rip), %0" : "=r"(p));
+    return (long)p;
+}
+
+static long load_section(void) {
+    long *p;
+    asm volatile("movq .rodata.got1@GOTPCREL(%%rip), %0" : "=r"(p));
+    return *p;
+}
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    // exit(0) if `missing` is 0 and the section holds 42
+    long status = load_missing() + load_section() - 42;
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}
@@ -0,0 +1,16 @@
+cd `dirname $0`
+LD=$1
+
+# GNU ld has no --icf
+ICF_FLAGS=""
+CFLAGS=""
+case $LD in
+*myld)
+    ICF_FLAGS="--icf=all"
+    CFLAGS="-DFOLDED"
+    ;;
+esac
+
+cc icf1.c -c -o icf1.o -m64 -fno-asynchronous-unwind-tables -g0 -O1 -ffunction-sections $CFLAGS
+cc dup.c -c -o dup.o -m64 -fno-asynchronous-unwind-tables -g0 -O1 -ffunction-sections
+$LD icf1.o dup.o $ICF_FLAGS -T icf1.ld -nostdlib
@@ -0,0 +1,14 @@
+int ten() { return 10; }
+int twenty() { return 20; }
+
+// identical code, but calling different functions
+__attribute__((noinline)) int call_ten() { return ten() + 1; }
+__attribute__((noinline)) int call_twenty() { return twenty() + 1; }
+
+// identical to `sum1` in icf1.c
+__attribute__((noinline)) int sum2(const int *a) { return a[0] + a[1] + a[2]; }
+
+// mutually recursive pairs which are identical to each other
+int even2(int n);
+__attribute__((noinline)) int odd2(int n) { return n == 0 ? 0 : even2(n - 1); }
+__attribute__((noinline)) int even2(int n) { return n == 0 ? 1 : odd2(n - 1); }
@@ -0,0 +1,31 @@
+int call_ten();
+int call_twenty();
+int sum2(const int *a);
+int even2(int n);
+
+__attribute__((noinline)) int sum1(const int *a) { return a[0] + a[1] + a[2]; }
+
+int odd1(int n);
+__attribute__((noinline)) int even1(int n) { return n == 0 ? 1 : odd1(n - 1); }
+__attribute__((noinline)) int odd1(int n) { return n == 0 ? 0 : even1(n - 1); }
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    int a[3] = {1, 2, 3};
+    // sections with different relocation targets must not be folded
+    long status = call_ten() - 11 + call_twenty() - 21;
+    status += sum1(a) - 6 + sum2(a) - 6;
+    status += even1(4) - 1 + even2(5);
+#ifdef FOLDED
+    // volatile, or the compiler assumes that distinct functions have distinct addresses
+    void *volatile fns[] = {sum1, sum2, even1, even2, call_ten, call_twenty};
+    status += fns[0] != fns[1];
+    status += fns[2] != fns[3];
+    status += fns[4] == fns[5];
+#endif
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}
@@ -0,0 +1,16 @@
+cd `dirname $0`
+LD=$1
+
+# GNU ld has no --icf
+ICF_FLAGS=""
+CFLAGS=""
+case $LD in
+*myld)
+    ICF_FLAGS="--icf=safe"
+    CFLAGS="-DFOLDED"
+    ;;
+esac
+
+cc icf2.c -c -o icf2.o -m64 -g0 -O1 -ffunction-sections $CFLAGS
+cc here.c -c -o here.o -m64 -g0 -O1 -ffunction-sections -fno-optimize-sibling-calls -fno-ipa-icf
+$LD icf2.o here.o $ICF_FLAGS -T icf2.ld -nostdlib
@@ -0,0 +1,6 @@
+// address in the caller which called where()
+__attribute__((noinline)) long where(void) { return (long)__builtin_return_address(0); }
+
+__attribute__((noinline)) long here1(void) { return where() + 1; }
+
+__attribute__((noinline)) long here2(void) { return where() + 1; }
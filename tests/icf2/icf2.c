@@ -0,0 +1,18 @@
+// built with unwind tables: the FDEs in .eh_frame refer to every function, but must not keep --icf=safe from
+// folding them
+long here1(void);
+long here2(void);
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    // here1() and here2() are identical and only called, so they are folded into one and return the same address
+    long status = here1() == here2();
+#ifdef FOLDED
+    status = !status;
+#endif
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}
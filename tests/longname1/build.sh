@@ -0,0 +1,6 @@
+cd `dirname $0`
+LD=$1
+
+cc longname1.c -c -o longname1.o -m64 -fno-asynchronous-unwind-tables -g0
+cc names.c -c -o names.o -m64 -fno-asynchronous-unwind-tables -g0 -ffunction-sections -fdata-sections -fno-inline
+$LD longname1.o names.o -T longname1.ld -nostdlib
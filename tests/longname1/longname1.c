@@ -0,0 +1,19 @@
+// these names share their first 40 bytes, and so do the sections they are in (-ffunction-sections)
+int a_function_with_a_long_name_that_is_shared_by_one(void);
+int a_function_with_a_long_name_that_is_shared_by_two(void);
+extern int a_variable_with_a_long_name_that_is_shared_by_one;
+extern int a_variable_with_a_long_name_that_is_shared_by_two;
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    // exit(1 + 2 + 10 + 20 - 33)
+    long status = a_function_with_a_long_name_that_is_shared_by_one() +
+                  a_function_with_a_long_name_that_is_shared_by_two() +
+                  a_variable_with_a_long_name_that_is_shared_by_one +
+                  a_variable_with_a_long_name_that_is_shared_by_two - 33;
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}
@@ -0,0 +1,13 @@
+int a_variable_with_a_long_name_that_is_shared_by_one = 10;
+int a_variable_with_a_long_name_that_is_shared_by_two = 20;
+
+static int a_local_function_with_a_long_name_that_is_shared_by_one(void) { return 1; }
+static int a_local_function_with_a_long_name_that_is_shared_by_two(void) { return 2; }
+
+int a_function_with_a_long_name_that_is_shared_by_one(void) {
+    return a_local_function_with_a_long_name_that_is_shared_by_one();
+}
+
+int a_function_with_a_long_name_that_is_shared_by_two(void) {
+    return a_local_function_with_a_long_name_that_is_shared_by_two();
+}
@@ -0,0 +1,14 @@
+cd `dirname $0`
+LD=$1
+
+# GNU ld only tail merges strings with -O1
+CFLAGS=""
+case $LD in
+*myld)
+    CFLAGS="-DTAIL_MERGED"
+    ;;
+esac
+
+cc merge1.c -c -o merge1.o -m64 -fno-asynchronous-unwind-tables -g0 -O1 $CFLAGS
+cc str.c -c -o str.o -m64 -fno-asynchronous-unwind-tables -g0 -O1
+$LD merge1.o str.o -T merge1.ld -nostdlib
@@ -0,0 +1,32 @@
+const char *hello2();
+const char *world2();
+const char *number();
+
+const char *hello1() { return "hello, world"; }
+
+static int length(const char *s) {
+    int n = 0;
+    while (s[n] != '\0') {
+        n++;
+    }
+    return n;
+}
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    // volatile, or the compiler assumes that the literals of different files have different addresses
+    const char *volatile strs[] = {hello1(), hello2(), world2(), number()};
+    // relocations against merged strings point to the right ones
+    long status = length(strs[0]) - 12 + length(strs[2]) - 5 + (strs[3][0] - '4') + (strs[3][1] - '2');
+    // identical strings are merged
+    status += strs[0] != strs[1];
+#ifdef TAIL_MERGED
+    // "world" is a suffix of "hello, world"
+    status += strs[2] != strs[0] + 7;
+#endif
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}
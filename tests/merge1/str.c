@@ -0,0 +1,4 @@
+const char *hello2() { return "hello, world"; }
+const char *world2() { return "world"; }
+
+const char *number() { return "42"; }
@@ -0,0 +1,15 @@
+cd `dirname $0`
+LD=$1
+
+# GNU ld has no --symbol-ordering-file
+ORDER_FLAGS=""
+CFLAGS=""
+case $LD in
+*myld)
+    ORDER_FLAGS="--symbol-ordering-file=order1.txt"
+    CFLAGS="-DORDERED"
+    ;;
+esac
+
+cc order1.c -c -o order1.o -m64 -fno-asynchronous-unwind-tables -g0 -O1 -ffunction-sections $CFLAGS
+$LD order1.o $ORDER_FLAGS -T order1.ld -nostdlib
@@ -0,0 +1,21 @@
+__attribute__((noinline)) int first() { return 1; }
+__attribute__((noinline)) int second() { return 2; }
+__attribute__((noinline)) static int helper() { return 3; }
+__attribute__((noinline)) int third() { return helper() + 1; }
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    // volatile, or the compiler assumes the order of the functions
+    unsigned long volatile addrs[] = {(unsigned long)first, (unsigned long)second, (unsigned long)helper,
+                                      (unsigned long)third};
+    long status = first() + second() + third() - 7;
+#ifdef ORDERED
+    // the listed functions come first in the order of order1.txt (static functions too), then the others
+    status += !(addrs[3] < addrs[2] && addrs[2] < addrs[0] && addrs[0] < addrs[1]);
+#endif
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}
@@ -0,0 +1,15 @@
+cd `dirname $0`
+LD=$1
+
+# GNU ld has no --hugepage-text
+HUGEPAGE_FLAGS=""
+CFLAGS=""
+case $LD in
+*myld)
+    HUGEPAGE_FLAGS="--hugepage-text"
+    CFLAGS="-DHUGEPAGE_TEXT"
+    ;;
+esac
+
+cc segment1.c -c -o segment1.o -m64 -fno-asynchronous-unwind-tables -g0 -O1 $CFLAGS
+$LD segment1.o $HUGEPAGE_FLAGS -T segment1.ld -nostdlib
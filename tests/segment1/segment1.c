@@ -0,0 +1,22 @@
+const char message[] = "read-only";
+long counter = 40;
+long zeros[1024];
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    long status = 0;
+    // .data and .bss are loaded writable, .rodata is loaded readable
+    counter += 2;
+    zeros[1023] = counter;
+    status += zeros[1023] != 42 || zeros[0] != 0;
+    status += message[0] != 'r';
+#ifdef HUGEPAGE_TEXT
+    // the text segment starts at a 2 MiB boundary
+    status += ((unsigned long)_start & 0x1fffff) != 0;
+#endif
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}
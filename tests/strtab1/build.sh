@@ -0,0 +1,20 @@
+cd `dirname $0`
+LD=$1
+
+cc strtab1.c -c -o strtab1.o -m64 -fno-asynchronous-unwind-tables -g0
+cc total.c -c -o total.o -m64 -fno-asynchronous-unwind-tables -g0
+$LD strtab1.o total.o -T strtab1.ld -nostdlib || exit 1
+
+# names which share their bytes in .strtab and .shstrtab must still read back whole
+case $LD in
+*myld)
+    symbols=`readelf -sW myld-a.out | awk '{ print $8 }'`
+    for name in strtab1.c total.c total subtotal get_total get_subtotal _start; do
+        echo "$symbols" | grep -qx "$name" || exit 1
+    done
+    sections=`readelf -SW myld-a.out | sed -n 's/^ *\[ *[0-9]*\] \([^ ]*\).*/\1/p'`
+    for name in .text .data .symtab .strtab .shstrtab; do
+        echo "$sections" | grep -qx -- "$name" || exit 1
+    done
+    ;;
+esac
@@ -0,0 +1,18 @@
+// each of these names is the tail of another one, and `total` is defined in both files, so the output .strtab can
+// store every name once and share the tails
+extern int subtotal;
+int get_total(void);
+int get_subtotal(void);
+
+static int total = 3;
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    // exit(1 + 2 + 3 + 4 - 10)
+    long status = get_total() + get_subtotal() + total + subtotal - 10;
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}
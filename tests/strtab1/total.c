@@ -0,0 +1,7 @@
+int subtotal = 4;
+
+static int total = 5;
+
+int get_total(void) { return total - 4; }
+
+int get_subtotal(void) { return 2; }
@@ -0,0 +1,24 @@
+cd `dirname $0`
+LD=$1
+
+# GNU ld has no --icf
+ICF_FLAGS=""
+case $LD in
+*myld)
+    ICF_FLAGS="--icf=all"
+    ;;
+esac
+
+cc symtab1.c -c -o symtab1.o -m64 -fno-asynchronous-unwind-tables -g0 -O1 -fcommon -ffunction-sections -fdata-sections
+$LD symtab1.o --gc-sections $ICF_FLAGS -T symtab1.ld -nostdlib || exit 1
+
+case $LD in
+*myld)
+    readelf -sW myld-a.out > symtab.log
+    grep -q "bad section index" symtab.log && exit 1
+    # unused() is removed by --gc-sections
+    grep -q " unused$" symtab.log && exit 1
+    # twin2() is folded into twin1()
+    [ "$(grep " twin1$" symtab.log | awk '{ print $2, $7 }')" = "$(grep " twin2$" symtab.log | awk '{ print $2, $7 }')" ] || exit 1
+    ;;
+esac
@@ -0,0 +1,20 @@
+// symbols of the output .symtab are in output sections: ones of removed sections are dropped, ones of folded
+// sections are in the section they were folded into
+int twin1(int x) { return x * 3 + 1; }
+int twin2(int x) { return x * 3 + 1; }
+int unused(void) { return 4; }
+const char *message = "symtab";
+int common_var;
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    int (*volatile f1)(int) = twin1;
+    int (*volatile f2)(int) = twin2;
+    // exit(0)
+    long status = f1(1) + f2(1) - 8 + message[0] - 's' + common_var;
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}
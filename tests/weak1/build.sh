@@ -0,0 +1,7 @@
+cd `dirname $0`
+LD=$1
+
+cc weak1.c -c -o weak1.o -m64 -fno-asynchronous-unwind-tables -g0
+cc weak.c -c -o weak.o -m64 -fno-asynchronous-unwind-tables -g0
+cc strong.c -c -o strong.o -m64 -fno-asynchronous-unwind-tables -g0
+$LD weak1.o weak.o strong.o -T weak1.ld -nostdlib
@@ -0,0 +1,2 @@
+// overridden by the strong definition in strong.c
+__attribute__((weak)) int g() { return 3; }
@@ -0,0 +1,12 @@
+int g();
+
+__attribute__((force_align_arg_pointer)) void _start() {
+    // exit(g() - 7)
+    long status = g() - 7;
+    asm volatile("mov $60, %%rax\n"
+                 "syscall"
+                 :
+                 : "D"(status));
+
+    __builtin_unreachable();
+}